@@ -4,6 +4,7 @@
 
 static CmHardware *hw_controller;
 static CmView *view;
+static CmPreset *preset;
 volatile static CmModel *model;
 
 void setup()
@@ -12,10 +13,13 @@ void setup()
   hw_controller = CmHardware::getInstance();
   model = CmModel::getInstance();
   view = CmView::getInstance();
+  preset = CmPreset::getInstance();
 
   hw_controller->setModel(model);
   hw_controller->setView(view);
+  hw_controller->setPreset(preset);
   view->setModel(model);
+  preset->setModel(model);
 
   model->initialize();
   hw_controller->initialize();
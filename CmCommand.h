@@ -0,0 +1,149 @@
+/*
+   Commands from the UI to the tick interrupt
+
+   CmModel queues tempo, swing, output settings, preset and start/stop
+   changes from the main loop, and CmModel::tick() takes them off the
+   queue at the start of the next Timer1 interrupt. There is exactly one
+   producer and one consumer, each side only writes its own index, and
+   one byte reads and writes are atomic on AVR, so neither side disables
+   interrupts.
+
+*/
+
+#ifndef CMCOMMAND_H
+#define CMCOMMAND_H
+
+#include <Arduino.h>
+#include "StepBits.h"
+
+/*
+   Power of two, at most 128. The main loop sends a few commands per pass
+   at most: a preset recall or a new seed is a single CMD_PRESET, its
+   output settings are handed over in CmModel::presetOutputs instead of
+   the queue.
+*/
+#define COMMAND_QUEUE_SIZE 8
+#define COMMAND_QUEUE_MASK (COMMAND_QUEUE_SIZE - 1)
+
+/* Preset recall: one CMD_PRESET whatever the number of outputs */
+#define PRESET_RECALL_COMMANDS 1
+static_assert(PRESET_RECALL_COMMANDS <= COMMAND_QUEUE_SIZE, "A preset recall must fit the command queue");
+
+/* Keeps the compiler from moving slot accesses past an index update */
+#define COMMAND_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+enum CommandType
+{
+  CMD_TEMPO = 0,
+  CMD_SWING = 1,
+  CMD_OUTPUT = 2,
+  CMD_START = 3,
+  CMD_STOP = 4,
+  CMD_QUANTUM = 5,
+  CMD_COMMIT = 6,
+  CMD_STAGE_TEMPO = 7, /* Tempo applied with the next commit */
+  CMD_SEED = 8,        /* Random seed applied with the next commit */
+  CMD_PRESET = 9       /* Preset recall or new seed, see PresetSettings */
+};
+
+/*
+   Output settings page values, staged per output until committed.
+*/
+struct OutputSettings
+{
+  uint8_t type;
+  uint8_t clockLength;
+  uint8_t gateLength;
+  uint8_t startDelayLength;
+  uint8_t lfoPhaseOffset;
+  uint8_t lfoRate;
+  uint8_t euclideanSteps;
+  uint8_t euclideanRotation;
+  uint8_t randomTriggerProbability;
+  uint8_t sequenceLength;
+  StepBits steps;
+};
+
+struct TempoSettings
+{
+  uint16_t period;
+  uint16_t remainder;
+  uint16_t divisor;
+};
+
+/*
+   Preset recall or new seed: output settings for the outputs in mask,
+   left by the UI in CmModel::presetOutputs, and seed, committed together
+   on quantum (PPQN, 0 for the current quantum). Tempo and swing are
+   taken over only when set.
+*/
+struct PresetSettings
+{
+  OutputMask mask;
+  bool tempoSet;
+  TempoSettings tempo;
+  bool swingSet;
+  uint8_t swing;
+  uint16_t seed;
+  uint16_t quantum;
+};
+
+struct Command
+{
+  uint8_t type;
+  uint8_t output; /* CMD_OUTPUT: output number */
+  uint8_t serial; /* CMD_OUTPUT: submit count, see CmModel::outputCommitPending() */
+  union
+  {
+    TempoSettings tempo;     /* CMD_TEMPO, CMD_STAGE_TEMPO */
+    uint8_t swing;           /* CMD_SWING */
+    uint16_t quantum;        /* CMD_QUANTUM, CMD_COMMIT: PPQN, 0 commits on the current quantum */
+    uint16_t seed;           /* CMD_SEED: 0 for the power-up entropy */
+    OutputSettings settings; /* CMD_OUTPUT */
+    PresetSettings preset;   /* CMD_PRESET */
+  };
+};
+
+static_assert(sizeof(PresetSettings) <= sizeof(OutputSettings), "CMD_PRESET must not make Command bigger");
+
+class CommandQueue
+{
+private:
+  Command slots[COMMAND_QUEUE_SIZE];
+
+  /* Free running, head written by the producer only, tail by the consumer */
+  volatile uint8_t head = 0;
+  volatile uint8_t tail = 0;
+
+public:
+  /*
+     Producer side. Returns false if the queue is full.
+  */
+  bool push(const Command &c)
+  {
+    uint8_t h = head;
+    if ((uint8_t)(h - tail) == COMMAND_QUEUE_SIZE)
+      return false;
+    slots[h & COMMAND_QUEUE_MASK] = c;
+    COMMAND_BARRIER();
+    head = h + 1;
+    return true;
+  }
+
+  /*
+     Consumer side. Returns false if the queue is empty.
+  */
+  bool pop(Command &c)
+  {
+    uint8_t t = tail;
+    if (head == t)
+      return false;
+    COMMAND_BARRIER();
+    c = slots[t & COMMAND_QUEUE_MASK];
+    COMMAND_BARRIER();
+    tail = t + 1;
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+   Hardware abstraction layer for Clock Module
+
+   Thin layer between sequencing code (Output, CmModel tick) and the
+   Arduino Micro. On target everything below compiles to the same port
+   writes and Arduino calls as before. When built with CM_HOST_SIM the
+   functions are implemented by the host simulator in sim/.
+
+*/
+
+#ifndef CMHAL_H
+#define CMHAL_H
+
+#include <Arduino.h>
+
+/*
+   Gate outputs by port. Gate state is kept as one byte per port holding
+   only the gate bits, so each port is updated with a single masked write
+   and all gates on the same port switch in the same cycle.
+
+     Output 0: PIN 12 PORTD PD6
+     Output 1: PIN 8  PORTB PB4
+     Output 2: PIN 4  PORTD PD4
+     Output 3: PIN A1 PORTF PF6
+     Output 4: PIN A2 PORTF PF5
+     Output 5: PIN A3 PORTF PF4
+     Output 6: PIN A4 PORTF PF1
+     Output 7: PIN A5 PORTF PF0
+*/
+#define GATE_PORT_B 0
+#define GATE_PORT_D 1
+#define GATE_PORT_F 2
+#define NUM_GATE_PORTS 3
+
+#define GATE_MASK_B (1 << 4)
+#define GATE_MASK_D ((1 << 6) | (1 << 4))
+#define GATE_MASK_F ((1 << 6) | (1 << 5) | (1 << 4) | (1 << 1) | (1 << 0))
+
+static const uint8_t PROGMEM GATE_PORT[] = {
+    GATE_PORT_D,
+    GATE_PORT_B,
+    GATE_PORT_D,
+    GATE_PORT_F,
+    GATE_PORT_F,
+    GATE_PORT_F,
+    GATE_PORT_F,
+    GATE_PORT_F};
+
+static const uint8_t PROGMEM GATE_BIT[] = {
+    1 << 6,
+    1 << 4,
+    1 << 4,
+    1 << 6,
+    1 << 5,
+    1 << 4,
+    1 << 1,
+    1 << 0};
+
+/*
+   CV outputs by PWM compare register, values[n] is output FIRST_PWM_OUTPUT + n.
+
+     Output 4: PIN 5  OC3A (Timer3, phase correct)
+     Output 5: PIN 6  OC4D (Timer4, phase and frequency correct)
+     Output 6: PIN 11 OC0A (Timer0, fast PWM)
+     Output 7: PIN 13 OC4A (Timer4, phase and frequency correct)
+
+   Timer modes are left as set up by Arduino init(). halPwmInit() connects
+   the compare outputs once, after that a value change is a plain register
+   write instead of analogWrite()'s pin lookup and timer reconfiguration.
+   The exception is 0 on output 6: in fast PWM a compare value of 0 still
+   gives a one count pulse every period, so as analogWrite() does, the
+   compare output is disconnected then and the pin (PB7, kept low) drives
+   0 V.
+*/
+
+/*
+   Power-up entropy for the random seed. On target the watchdog timer,
+   which runs from its own RC oscillator, times HAL_ENTROPY_SAMPLES
+   timeouts of about 16 ms, and the Timer0 count at each timeout is mixed
+   in. The RC oscillator drifts against the crystal with temperature and
+   supply, so the low bits of the count differ from one power-up to the
+   next. Polled with interrupts off, before the Timer1 interrupt runs;
+   takes about a quarter of a second.
+*/
+#define HAL_ENTROPY_SAMPLES 16
+
+/*
+   EEPROM, used by the preset journal. halEepromWrite() must only be called
+   when halEepromReady(), it then starts the write without waiting and
+   skips bytes that already hold the value.
+*/
+
+#ifdef CM_HOST_SIM
+
+void halWriteGatePorts(const volatile uint8_t *ports);
+void halPwmInit();
+void halPwmLatch(const volatile uint8_t *values);
+void halSetTimerCompare(uint16_t ocr);
+uint16_t halTimerCompare();
+uint16_t halTimerCount();
+bool halTimerOverrun();
+uint32_t halEntropy();
+uint8_t halEepromRead(uint16_t address);
+bool halEepromReady();
+void halEepromWrite(uint16_t address, uint8_t value);
+
+#else
+
+#include <avr/eeprom.h>
+
+inline void halWriteGatePorts(const volatile uint8_t *ports)
+{
+  PORTB = (PORTB & ~GATE_MASK_B) | ports[GATE_PORT_B];
+  PORTD = (PORTD & ~GATE_MASK_D) | ports[GATE_PORT_D];
+  PORTF = (PORTF & ~GATE_MASK_F) | ports[GATE_PORT_F];
+}
+
+inline void halPwmInit()
+{
+  TCCR3A |= (1 << COM3A1);
+  TCCR4C |= (1 << COM4D1);
+  TCCR0A |= (1 << COM0A1);
+  TCCR4A |= (1 << COM4A1);
+  PORTB &= ~(1 << PB7);
+}
+
+inline void halPwmLatch(const volatile uint8_t *values)
+{
+  OCR3A = values[0];
+  OCR4D = values[1];
+  if (values[2])
+  {
+    OCR0A = values[2];
+    TCCR0A |= (1 << COM0A1);
+  }
+  else
+    TCCR0A &= ~(1 << COM0A1);
+  OCR4A = values[3];
+}
+
+/*
+   Timer1 compare value (CTC mode, period is ocr + 1 timer ticks). Callers
+   outside the Timer1 interrupt must disable interrupts around this.
+*/
+inline void halSetTimerCompare(uint16_t ocr)
+{
+  OCR1A = ocr;
+}
+
+inline uint16_t halTimerCompare()
+{
+  return OCR1A;
+}
+
+/*
+   Timer1 count, 0.5 us per count from the start of the current tick.
+   Used to time work inside the tick; the host simulator returns host
+   time in the same unit.
+*/
+inline uint16_t halTimerCount()
+{
+  return TCNT1;
+}
+
+/*
+   True inside the tick once the compare match that starts the next tick
+   has happened, i.e. the tick has run longer than its period. TCNT1 has
+   then restarted from 0.
+*/
+inline bool halTimerOverrun()
+{
+  return TIFR1 & (1 << OCF1A);
+}
+
+inline uint32_t halEntropy()
+{
+  uint32_t e = 0;
+  uint8_t sreg = SREG;
+
+  noInterrupts();
+  MCUSR &= ~(1 << WDRF);
+  WDTCSR = (1 << WDCE) | (1 << WDE);
+  WDTCSR = (1 << WDIE) | (1 << WDIF); /* Interrupt mode, 16 ms, flag polled */
+  for (uint8_t i = 0; i < HAL_ENTROPY_SAMPLES; i++)
+  {
+    while (!(WDTCSR & (1 << WDIF)))
+      ;
+    WDTCSR |= (1 << WDIF);
+    e = (e << 5 | e >> 27) ^ TCNT0;
+  }
+  WDTCSR = (1 << WDCE) | (1 << WDE);
+  WDTCSR = 0;
+  SREG = sreg;
+  return e;
+}
+
+inline uint8_t halEepromRead(uint16_t address)
+{
+  return eeprom_read_byte((const uint8_t *)address);
+}
+
+inline bool halEepromReady()
+{
+  return eeprom_is_ready();
+}
+
+inline void halEepromWrite(uint16_t address, uint8_t value)
+{
+  eeprom_update_byte((uint8_t *)address, value);
+}
+
+#endif
+
+#endif
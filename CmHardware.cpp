@@ -9,14 +9,28 @@
 
 #include <avr/wdt.h>
 
-#define CPU_FREQ 16000000
-#define PRESCALER 8
 #define RUN_BUTTON_PIN A0
 #define BUTTON_PIN 7
-#define RANDOM_SEED_PIN 9
 #define ROTARY_A_PIN 0
 #define ROTARY_B_PIN 1
 
+/*
+   Rotary encoder on pins 0 (PD2, INT2) and 1 (PD3, INT3). Both edges of
+   both pins interrupt, and each transition between quadrature states
+   (A << 1 | B) is looked up in ROTARY_TRANSITION: +1 for a quarter step
+   in the direction that increments, -1 for the other way, 0 for no
+   change or an invalid jump (bounce, missed edge). One detent is
+   ROTARY_QUARTERS_PER_DETENT quarter steps.
+*/
+#define ROTARY_QUARTERS_PER_DETENT 4
+#define ROTARY_MAX_DETENTS 127
+
+static const int8_t PROGMEM ROTARY_TRANSITION[] = {
+    0, -1, 1, 0,
+    1, 0, 0, -1,
+    -1, 0, 0, 1,
+    0, 1, -1, 0};
+
 /*
 
   0       Rotary A
@@ -65,19 +79,27 @@ void CmHardware::initialize()
   pinMode(A4, OUTPUT);
   pinMode(A5, OUTPUT);
   pinMode(CLOCK_INPUT, INPUT);
-  randomSeed(RANDOM_SEED_PIN);
+  rotaryState = rotaryReadState();
+  halPwmInit();
   resetOutputPins();
-  updateOCR1A_limit();
   noInterrupts();
   TCCR1A = 0; // Clear TIMER1 registers.
   TCCR1B = 0;
   TIFR1 = 0;
   TIMSK1 = 0;
-  OCR1A = (int)OCR1A_limit; // Set counter limit
+  OCR1A = model->clockPeriod - 1; // Set counter limit
   TCCR1B |= (1 << WGM12);   // Set time compare CTC 4 mode on.
   TCCR1B |= (1 << CS11);    // Set prescaler to 8
   TIMSK1 |= (1 << OCIE1A);  // Enable counter output compare interrupt.
+  PCMSK0 |= (1 << PCINT5);  // Clock input, pin 9 = PB5
+  PCICR |= (1 << PCIE0);    // Enable pin change interrupt for clock sync.
+  EICRA |= (1 << ISC20) | (1 << ISC30); // Rotary encoder, any edge on INT2/INT3
+  EIFR = (1 << INTF2) | (1 << INTF3);
+  EIMSK |= (1 << INT2) | (1 << INT3);
   interrupts();
+
+  /* Needs the tick running to take the recalled settings */
+  preset->initialize();
   splashFlash();
 }
 
@@ -112,19 +134,6 @@ void CmHardware::splashFlash()
   view->render();
 }
 
-void CmHardware::updateOCR1A_limit()
-{
-
-  uint8_t &BPM = model->BPM;
-
-  double iHz = (double)BPM * (double)PPQN * (double)0.0166666666666666666667;
-  OCR1A_limit = (double)CPU_FREQ / (double)PRESCALER / iHz;
-
-  noInterrupts();
-  OCR1A = (int)OCR1A_limit;
-  interrupts();
-}
-
 /********************************************************************
 
        MAIN CONTROLLER LOOP
@@ -141,46 +150,77 @@ void CmHardware::runModule()
 
     wdt_reset();
 
+    uint32_t loopStartMicros = micros();
+
     /*
        Start/stop button
     */
     bool runButtonState = !digitalRead(RUN_BUTTON_PIN);
+    bool clockInputState = digitalRead(CLOCK_INPUT);
 
-    if (!runButtonState && model->clockRunning)
+    if (!runButtonState)
     {
-      model->clockStopped();
-      model->clockRunning = runButtonState;
-      resetOutputPins();
+      model->setRunning(false);
+    }
+    else if (clockInputState)
+    {
+      model->setRunning(true);
     }
 
-    bool clockInputState = digitalRead(CLOCK_INPUT);
-
-    if (clockInputState)
+    /*
+       External clock sync: timeout and detected tempo on BPM page
+    */
+    model->syncCheckTimeout(micros());
+    if (model->syncActive && model->currentMode == MODE_BPM && !screensaver &&
+        millis() - lastSyncRenderMillis > SYNC_DISPLAY_UPDATE_MILLIS)
     {
-      model->clockRunning = runButtonState;
+      lastSyncRenderMillis = millis();
+      model->renderView = true;
     }
 
+#if PROFILE_TICK
     /*
-       Rotary rotation
+       Tick statistics: Diagnostics page refresh, dump or clear on serial
     */
-    stateRotaryA = (stateRotaryA << 1) | digitalRead(ROTARY_A_PIN) | 0xe000;
-    if (stateRotaryA == 0xf000)
+    if (model->currentMode == MODE_DIAGNOSTICS && !screensaver &&
+        millis() - lastDiagnosticsRenderMillis > DIAGNOSTICS_UPDATE_MILLIS)
     {
+      lastDiagnosticsRenderMillis = millis();
+      model->renderView = true;
+    }
+    if (Serial.available())
+    {
+      int c = Serial.read();
+      if (c == 'p')
+        printTickProfile();
+      else if (c == 'c')
+        model->clearTickProfile();
+    }
+#endif
 
-      stateRotaryA = 0x0000;
-      volatile CmModel *model = CmModel::getInstance();
-      volatile CmView *view = CmView::getInstance();
-      bool rotaryDirection = LOW;
-      if (digitalRead(ROTARY_B_PIN))
-        rotaryDirection = HIGH;
+    /*
+       Rotary rotation: drain detents counted by the encoder interrupt
+    */
+    noInterrupts();
+    int8_t detents = rotaryDetents;
+    rotaryDetents = 0;
+    interrupts();
 
+    if (detents != 0)
+    {
       if (screensaver)
       {
         stopScreensaver();
       }
       else
       {
-        model->handleRotary(rotaryDirection);
+        /* Button low: turned while held */
+        bool held = !buttonStatePrev;
+        for (; detents > 0; detents--)
+          model->handleRotary(true, held);
+        for (; detents < 0; detents++)
+          model->handleRotary(false, held);
+        buttonTurned = buttonTurned || held;
         view->render();
       }
       lastControlMillis = millis();
@@ -207,6 +247,10 @@ void CmHardware::runModule()
       {
         stopScreensaver();
       }
+      else if (buttonTurned)
+      {
+        buttonTurned = false;
+      }
       else
       {
 
@@ -234,6 +278,18 @@ void CmHardware::runModule()
       model->renderView = false;
     }
 
+    /*
+       Display update, one slice per pass so that controls are polled
+       between slices
+    */
+    if (!screensaver)
+      view->renderSlice();
+
+    /*
+       Preset save in progress, one EEPROM byte per pass
+    */
+    preset->update();
+
     /*
        Screensaver
     */
@@ -245,8 +301,81 @@ void CmHardware::runModule()
         view->displayScreensaver();
       }
     }
+
+    /*
+       Worst-case main loop latency
+    */
+    uint32_t loopMicros = micros() - loopStartMicros;
+    if (loopMicros > loopMicrosMax)
+      loopMicrosMax = loopMicros;
+
+    if (DEBUG_LOOP && millis() - lastLoopReportMillis > DEBUG_LOOP_REPORT_MILLIS)
+    {
+      lastLoopReportMillis = millis();
+      Serial.print(F("Loop max us: "));
+      Serial.println(loopMicrosMax);
+      Serial.print(F("Commit max timer ticks: "));
+      Serial.println(model->commitTimerTicksMax);
+      Serial.print(F("Preset recall us: "));
+      Serial.println(preset->recallMicros);
+      Serial.print(F("Commit wait ticks: "));
+      Serial.println(model->commitWaitTicks);
+      loopMicrosMax = 0;
+    }
+  }
+}
+
+#if PROFILE_TICK
+extern char __heap_start;
+extern char *__brkval;
+
+/*
+   Bytes between the top of the heap (or of .bss, nothing is malloc'ed)
+   and the stack pointer of the main loop: what is left for the interrupt
+   stack frames
+*/
+static int freeStack()
+{
+  char top;
+  return &top - (__brkval ? __brkval : &__heap_start);
+}
+
+/*
+   Tick statistics as text, one line per tick kind: the kind, the count
+   in each histogram bucket and the worst cost in Timer1 counts (0.5 us),
+   then the free stack
+*/
+void CmHardware::printTickProfile()
+{
+  TickProfile p;
+  model->copyTickProfile(p);
+
+  Serial.print(F("Ticks "));
+  Serial.print(p.ticks);
+  Serial.print(F(" overruns "));
+  Serial.println(p.overruns);
+  Serial.print(F("Bucket limits"));
+  for (uint8_t b = 0; b < TICK_PROFILE_BUCKETS - 1; b++)
+  {
+    Serial.print(' ');
+    Serial.print(TickProfile::bucketLimit(b));
+  }
+  Serial.println();
+  for (uint8_t k = 0; k < NUM_TICK_KINDS; k++)
+  {
+    Serial.print(TICK_KIND_TO_STR[k]);
+    for (uint8_t b = 0; b < TICK_PROFILE_BUCKETS; b++)
+    {
+      Serial.print(' ');
+      Serial.print(p.histogram[k][b]);
+    }
+    Serial.print(F(" max "));
+    Serial.println(p.worst[k]);
   }
+  Serial.print(F("Free stack "));
+  Serial.println(freeStack());
 }
+#endif
 
 void CmHardware::stopScreensaver()
 {
@@ -257,114 +386,86 @@ void CmHardware::stopScreensaver()
 
 /********************************************************************
 
-       TIMER INTERRUPT HANDLER
+       CLOCK INPUT INTERRUPT HANDLER
 
+   Pin 9 (PB5) has no input capture unit on the 32U4 (ICP1 is pin 4,
+   used by output 2), so rising edges are timestamped in the pin change
+   interrupt instead.
 */
 
-ISR(TIMER1_COMPA_vect)
+ISR(PCINT0_vect)
 {
+  if (PINB & (1 << PB5))
+    CmModel::getInstance()->syncPulse(micros());
+}
 
-  volatile CmModel *model = CmModel::getInstance();
-
-  if (!model->clockRunning)
-    return;
+/********************************************************************
 
-  volatile int &i_c = model->interruptCounter;
+       ROTARY ENCODER INTERRUPT HANDLER
 
-  /*
-     PIN 12: PORTD PD6
-     PIN 8:  PORTB PB4
-     PIN 4:  PORTD PD4
-     PIN A1: PORTF PF6
-  */
+*/
 
-  /*
-      Update output states
-  */
-  model->outputs[0]->d_out ? PORTD |= (1 << PD6) : PORTD &= ~(1 << PD6);
-  model->outputs[1]->d_out ? PORTB |= (1 << PB4) : PORTB &= ~(1 << PB4);
-  model->outputs[2]->d_out ? PORTD |= (1 << PD4) : PORTD &= ~(1 << PD4);
-  model->outputs[3]->d_out ? PORTF |= (1 << PF6) : PORTF &= ~(1 << PF6); // A1
-  model->outputs[4]->d_out ? PORTF |= (1 << PF5) : PORTF &= ~(1 << PF5); // A2
-  model->outputs[5]->d_out ? PORTF |= (1 << PF4) : PORTF &= ~(1 << PF4); // A3
-  model->outputs[6]->d_out ? PORTF |= (1 << PF1) : PORTF &= ~(1 << PF1); // A4
-  model->outputs[7]->d_out ? PORTF |= (1 << PF0) : PORTF &= ~(1 << PF0); // A5
-
-  /* A1, A2, A3, A4, A5 */
-  /* etc rest of pins */
-
-  if (DEBUG_INTERRUPT)
-  {
-    if (i_c % DEBUG_INTERRUPT_DIVIDER == 0)
-    {
-      Serial.print(F(" Int "));
-      Serial.print(i_c);
-      Serial.print(F("   \t : "));
-      for (Output *o : model->outputs)
-      {
-        if (o->type == SAW || o->type == SAW_INVERTED || o->type == SINE || o->type == VOLTAGE)
-          Serial.print(o->pwm_out);
-        else
-          Serial.print(o->d_out ? F("X    ") : F("-    "));
-      }
-    }
-  }
+uint8_t CmHardware::rotaryReadState()
+{
+  uint8_t pins = PIND;
+  return ((pins >> (PD2 - 1)) & 2) | ((pins >> PD3) & 1);
+}
 
-  /*
-     Increment PPQN/interrupt counter
-  */
-  if (++i_c == INTERRUPT_COUNTER_LIMIT)
-    i_c = 0;
+void CmHardware::rotaryEdge()
+{
+  uint8_t state = rotaryReadState();
+  rotaryQuarters += (int8_t)pgm_read_byte(&ROTARY_TRANSITION[(rotaryState << 2) | state]);
+  rotaryState = state;
 
-  /*
-    Commit output/swing changes at start of a bar
-  */
-  if (model->outputChangesReadyForCommit && i_c % PPQN_BAR == 0)
+  if (rotaryQuarters >= ROTARY_QUARTERS_PER_DETENT)
   {
-    model->commitOutputSettingsChange();
+    rotaryQuarters -= ROTARY_QUARTERS_PER_DETENT;
+    if (rotaryDetents < ROTARY_MAX_DETENTS)
+      rotaryDetents++;
   }
-  if (model->swingChangeReadyForCommit && i_c % PPQN_BAR == 0)
+  else if (rotaryQuarters <= -ROTARY_QUARTERS_PER_DETENT)
   {
-    model->commitSwingChange();
+    rotaryQuarters += ROTARY_QUARTERS_PER_DETENT;
+    if (rotaryDetents > -ROTARY_MAX_DETENTS)
+      rotaryDetents--;
   }
+}
 
-  /*
-     Calculate new gate values for next cycle
-  */
-  for (int i = 0; i < NUM_OUTPUTS; i++)
-  {
+ISR(INT2_vect)
+{
+  CmHardware::getInstance()->rotaryEdge();
+}
 
-    Output *o = model->outputs[i];
+ISR(INT3_vect, ISR_ALIASOF(INT2_vect));
 
-    if (i_c == o->eventTime)
-    {
+/********************************************************************
 
-      switch (o->event)
-      {
+       TIMER INTERRUPT HANDLER
 
-      case GATE_CLOSE:
-        o->d_out = false;
-        o->pwm_out = 0;
-        if (o->clockLength < CLOCK_LENGTH_SWINGABLE_LIMIT)
-        {
-          uint8_t swing = model->swingTable[o->clockLength];
-          o->setSwingGateOpenEvent(i_c, swing);
-        }
+*/
+
+ISR(TIMER1_COMPA_vect)
+{
+
+  volatile CmModel *model = CmModel::getInstance();
+
+  if (DEBUG_INTERRUPT && model->clockRunning)
+  {
+    if (model->interruptCounter % DEBUG_INTERRUPT_DIVIDER == 0)
+    {
+      Serial.print(F(" Int "));
+      Serial.print(model->interruptCounter);
+      Serial.print(F("   \t : "));
+      for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+      {
+        Output *o = model->outputs[i];
+        if (o->isCv())
+          Serial.print(o->pwm_out);
         else
-          o->setGateOpenEvent(i_c);
-        break;
-      case GATE_OPEN:
-        o->pwm_out = 0;
-        if (o->gateOpen)
-          o->d_out = true;
-        o->setGateCloseEvent(i_c);
-        break;
-      case PWM_EVENT:
-        analogWrite(o->ANALOG_PIN, o->pwm_out);
-        o->handlePwmEvent(i_c);
-        o->setPwmEvent(i_c + PWM_EVENT_PPQN);
-        break;
+          Serial.print(model->gateLevel(i) ? F("X    ") : F("-    "));
       }
     }
   }
+
+  model->tick();
 }
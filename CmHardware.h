@@ -10,6 +10,7 @@
 #include <Arduino.h>
 #include "CmModel.h"
 #include "CmView.h"
+#include "CmPreset.h"
 #include "Output.h"
 
 class CmHardware
@@ -22,21 +23,14 @@ private:
 
   CmModel *model;
   CmView *view;
+  CmPreset *preset;
 
   bool screensaver = false;
 
-  uint32_t OCR1A_limit;
-
   void resetOutputPins()
   {
-    digitalWrite(PIN_OUTPUT0, LOW);
-    digitalWrite(PIN_OUTPUT1, LOW);
-    digitalWrite(PIN_OUTPUT2, LOW);
-    digitalWrite(PIN_OUTPUT3, LOW);
-    digitalWrite(PIN_OUTPUT4, LOW);
-    digitalWrite(PIN_OUTPUT5, LOW);
-    digitalWrite(PIN_OUTPUT6, LOW);
-    digitalWrite(PIN_OUTPUT7, LOW);
+    static const uint8_t allLow[NUM_GATE_PORTS] = {0};
+    halWriteGatePorts(allLow);
   }
 
   Output *outputs[8];
@@ -44,14 +38,30 @@ private:
   bool buttonStatePrev = true;
   uint32_t lastButtonPressMillis = 0;
   uint32_t buttonDownMillis = 0;
+  bool buttonTurned = false; /* Turned while held, no press on release */
 
-  uint16_t stateRotaryA = 0;
   uint16_t stateRunButton = 0;
 
+  /*
+     Rotary encoder decoder state, updated in the INT2/INT3 interrupt.
+     rotaryDetents is drained by the main loop.
+  */
+  uint8_t rotaryState = 0;
+  int8_t rotaryQuarters = 0;
+  volatile int8_t rotaryDetents = 0;
+
+  static uint8_t rotaryReadState();
+
   uint32_t lastControlMillis = 0;
+  uint32_t lastSyncRenderMillis = 0;
+  uint32_t lastLoopReportMillis = 0;
+  uint32_t lastDiagnosticsRenderMillis = 0;
 
   void stopScreensaver();
   void splashFlash();
+#if PROFILE_TICK
+  void printTickProfile();
+#endif
 
 public:
   // Static method to get the instance
@@ -71,15 +81,29 @@ public:
     this->view = view;
   }
 
+  void setPreset(CmPreset *preset)
+  {
+    this->preset = preset;
+  }
+
   CmModel *getModel()
   {
     return model;
   }
 
-  void updateOCR1A_limit();
+  /*
+     Longest main loop pass in microseconds, including the display
+     slice rendered in it
+  */
+  uint32_t loopMicrosMax = 0;
 
   void initialize();
 
+  /*
+     Encoder pin change, called from the INT2/INT3 interrupt
+  */
+  void rotaryEdge();
+
   void runModule();
 };
 
@@ -1,8 +1,17 @@
 #include "CmModel.h"
-#include "CmHardware.h"
+#include "CmPreset.h"
 
 #define RANDOM_TRIGGER_PROBABILITY_CHANGE_STEP_SIZE 5
 
+static Output o0(PIN_OUTPUT0, NO_ANALOG_OUTPUT);
+static Output o1(PIN_OUTPUT1, NO_ANALOG_OUTPUT);
+static Output o2(PIN_OUTPUT2, NO_ANALOG_OUTPUT);
+static Output o3(PIN_OUTPUT3, NO_ANALOG_OUTPUT);
+static Output o4(PIN_OUTPUT4, PIN_ANALOG4);
+static Output o5(PIN_OUTPUT5, PIN_ANALOG5);
+static Output o6(PIN_OUTPUT6, PIN_ANALOG6);
+static Output o7(PIN_OUTPUT7, PIN_ANALOG7);
+
 CmModel::CmModel()
 {
   outputs[0] = &o0;
@@ -13,22 +22,57 @@ CmModel::CmModel()
   outputs[5] = &o5;
   outputs[6] = &o6;
   outputs[7] = &o7;
+
+  for (uint8_t i = 0; i < EVENT_WHEEL_SIZE; i++)
+  {
+    eventWheel[i] = 0;
+  }
+  for (uint8_t i = 0; i < NUM_GATE_PORTS; i++)
+  {
+    gatePorts[i] = 0;
+  }
+  for (uint8_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+  {
+    pwmShadow[i] = 0;
+  }
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    event[i] = NO_EVENT;
+    eventTime[i] = 0;
+    outputSubmitted[i] = 0;
+    outputStaged[i] = 0;
+    outputCommitted[i] = 0;
+  }
 }
 
 void CmModel::initialize()
 {
+  entropy = halEntropy();
+  uiRandom.seed(entropy);
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    outputs[i]->rng.seed(streamSeed(entropy, i));
+  }
+
   BPM = DEFAULT_BPM;
+  bpmFraction = 0;
+  updateClockPeriod();
   swing = DEFAULT_SWING;
-  updateSwingTable();
+  updateSwingTable(swing);
+  quantum = DEFAULT_QUANTUM;
+  commitQuantum = QUANTUM_TO_PPQN[quantum];
   setupDefaultOutputs();
   resetOutputs();
   currentMode = MODE_BPM;
+
+  /* Timer1 interrupt is not running yet */
+  processCommands();
 }
 
 void CmModel::setupDefaultOutputs()
 {
 
-  for (int i; i < NUM_OUTPUTS; i++)
+  for (int i = 0; i < NUM_OUTPUTS; i++)
   {
     Output *o = outputs[i];
     o->setOutputType(CLOCK);
@@ -36,6 +80,7 @@ void CmModel::setupDefaultOutputs()
     o->setGateLength(CLOCK_1x32);
     o->setStartDelayLength(NO_CLOCK);
     o->setEuclideanSteps(DEFAULT_EUCLIDEAN_STEPS);
+    o->setEuclideanRotation(0);
     o->setRandomTriggerProbability(DEFAULT_RANDOM_TRIGGER_PROBABILITY);
     o->generateSequence(DEFAULT_SEQUENCE_LENGTH);
   }
@@ -86,16 +131,16 @@ void CmModel::setupDefaultOutputs()
   o7.setGateLength(CLOCK_2x1);
 }
 
-void CmModel::updateSwingTable()
+void CmModel::updateSwingTable(uint8_t s)
 {
   swingTable[0] = 0;
-  swingTable[1] = swing / 16;
-  swingTable[2] = swing / 8;
-  swingTable[3] = swing / 4;
-  swingTable[4] = swing / 2;
-  swingTable[5] = swing;
+  swingTable[1] = s / 16;
+  swingTable[2] = s / 8;
+  swingTable[3] = s / 4;
+  swingTable[4] = s / 2;
+  swingTable[5] = s;
 
-  if (swing > 0)
+  if (s > 0)
   {
     for (uint8_t i = 0; i < 6; i++)
     {
@@ -109,13 +154,21 @@ void CmModel::resetOutputs()
 {
   for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
   {
-    resetOutput(outputs[i]);
+    resetOutput(i);
   }
+  updateOutputPorts(~(OutputMask)0);
 }
 
-void CmModel::resetOutput(Output *o)
+/*
+  Restart output n from the current tick. Port state is left to
+  updateOutputPorts(), so that resetting several outputs updates it once.
+*/
+void CmModel::resetOutput(uint8_t n)
 {
 
+  Output *o = outputs[n];
+
+  unscheduleOutput(n);
   o->reset();
 
   if (o->clockLength < CLOCK_LENGTH_SWINGABLE_LIMIT)
@@ -129,28 +182,64 @@ void CmModel::resetOutput(Output *o)
 
   if (o->startDelayLength > 0)
   {
-    if (o->type == SAW || o->type == SAW_INVERTED || o->type == SINE || o->type == VOLTAGE)
-      o->setDelayedEvent(PWM_EVENT, interruptCounter + PWM_EVENT_PPQN);
+    if (o->isCv())
+      scheduleOutput(n, PWM_EVENT, o->delayedEventTime(interruptCounter + PWM_EVENT_PPQN));
     else
-      o->setDelayedEvent(GATE_OPEN, interruptCounter);
+      scheduleOutput(n, GATE_OPEN, o->delayedEventTime(interruptCounter));
   }
   else
   {
-    if (o->type == SAW || o->type == SAW_INVERTED || o->type == SINE || o->type == VOLTAGE)
+    if (o->isCv())
     {
-      o->setPwmEvent(interruptCounter + 1);
+      scheduleOutput(n, PWM_EVENT, interruptCounter + 1);
     }
     else
     {
-      o->setGateCloseEvent(interruptCounter);
+      scheduleOutput(n, GATE_CLOSE, o->nextGateCloseTime(interruptCounter));
+    }
+  }
+}
+
+/*
+  Rebuild port gate bits from d_out of all outputs and latch the CV of the
+  outputs in reset. Needed after outputs are reset outside of the tick's
+  event handling.
+*/
+void CmModel::updateOutputPorts(OutputMask reset)
+{
+  uint8_t ports[NUM_GATE_PORTS] = {0};
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    if (outputs[i]->d_out)
+      ports[pgm_read_byte(&GATE_PORT[i])] |= pgm_read_byte(&GATE_BIT[i]);
+  }
+  for (uint8_t i = 0; i < NUM_GATE_PORTS; i++)
+  {
+    gatePorts[i] = ports[i];
+  }
+
+  if (reset >> FIRST_PWM_OUTPUT)
+  {
+    for (uint8_t i = FIRST_PWM_OUTPUT; i < NUM_OUTPUTS; i++)
+    {
+      if (reset & ((OutputMask)1 << i))
+        pwmShadow[i - FIRST_PWM_OUTPUT] = outputs[i]->pwm_out;
     }
+    halPwmLatch(pwmShadow);
   }
 }
 
 void CmModel::clockStopped()
 {
+  static const uint8_t allLow[NUM_GATE_PORTS] = {0};
+
+  /* Stopped ticks come one per period, so a start is taken without delay */
+  wakeTicks = 1;
+  halSetTimerCompare(clockPeriod - 1);
+
   resetInterruptCounter();
   resetOutputs();
+  halWriteGatePorts(allLow);
 }
 
 void CmModel::handleButton()
@@ -170,27 +259,47 @@ void CmModel::handleButton()
     viewChanged = true;
     break;
 
+  /* Setup pages, the last one goes back to Swing */
+  case MODE_COMMIT:
+    currentMode = MODE_PRESET;
+    viewChanged = true;
+    break;
+
+  case MODE_PRESET:
+    currentMode = MODE_SEED;
+    editSeed = seed;
+    viewChanged = true;
+    break;
+
+  case MODE_SEED:
+    currentMode = PROFILE_TICK ? MODE_DIAGNOSTICS : MODE_SWING;
+    viewChanged = true;
+    break;
+
+  case MODE_DIAGNOSTICS:
+    currentMode = MODE_SWING;
+    viewChanged = true;
+    break;
+
   case MODE_OUTPUT_LIST:
     /* Change to edit mode, current selected output */
-    /* Handle changes on one output at a time */
-    if (outputChangesReadyForCommit)
+    if (!prepareOutputSettingsChange())
       return;
     currentMode = MODE_OUTPUT_SETTINGS;
     viewChanged = true;
-    prepareOutputSettingsChange();
     break;
 
   case MODE_OUTPUT_SETTINGS:
     currentRow++;
-    if ((editType == VOLTAGE && currentRow > 2) || currentRow > 3)
+    if ((editType == VOLTAGE && currentRow > 2) ||
+        (editType != SAW && editType != SAW_INVERTED && editType != SINE && editType != EUCLIDEAN && currentRow > 3) ||
+        (editType == EUCLIDEAN && currentRow > 4) ||
+        currentRow > 5)
     {
       currentMode = MODE_OUTPUT_LIST;
       viewChanged = true;
       currentRow = currentOutput;
-      if (clockRunning)
-        outputChangesReadyForCommit = true;
-      else
-        commitOutputSettingsChange();
+      submitOutputSettingsChange();
     }
     break;
   }
@@ -201,13 +310,40 @@ void CmModel::handleButtonLongPress()
   switch (currentMode)
   {
   case MODE_BPM:
-  case MODE_SWING:
     currentMode = MODE_OUTPUT_LIST;
     viewChanged = true;
     currentRow = 0;
     break;
 
+  case MODE_SWING:
+    currentMode = MODE_COMMIT;
+    viewChanged = true;
+    break;
+
+  case MODE_COMMIT:
+    currentMode = MODE_SWING;
+    viewChanged = true;
+    break;
+
+  case MODE_PRESET:
+    presetRun();
+    break;
+
+  case MODE_SEED:
+    seedRun();
+    break;
+
+#if PROFILE_TICK
+  case MODE_DIAGNOSTICS:
+    clearTickProfile();
+    renderView = true;
+    break;
+#endif
+
   case MODE_OUTPUT_LIST:
+    /* Commit staged outputs, or leave if there is nothing to commit */
+    if (commitStagedOutputs())
+      break;
     currentMode = MODE_BPM;
     viewChanged = true;
     break;
@@ -228,7 +364,12 @@ void CmModel::handleButtonLongPress()
   }
 }
 
-void CmModel::handleRotary(bool increment)
+/*
+  Encoder detent, held while the button is down. Turning with the button
+  held sets the hundredths on the BPM page and acts as a plain turn on
+  the other pages.
+*/
+void CmModel::handleRotary(bool increment, bool held)
 {
 
   int8_t modifier = increment ? 1 : -1;
@@ -236,13 +377,32 @@ void CmModel::handleRotary(bool increment)
   switch (currentMode)
   {
   case MODE_BPM:
-    bpmChange(modifier);
+    if (held)
+      bpmFineChange(modifier);
+    else
+      bpmChange(modifier);
     break;
 
   case MODE_SWING:
     swingChange(modifier);
     break;
 
+  case MODE_COMMIT:
+    quantumChange(modifier);
+    break;
+
+  case MODE_PRESET:
+    presetChange(modifier);
+    break;
+
+  case MODE_SEED:
+    seedChange(modifier);
+    break;
+
+  case MODE_DIAGNOSTICS:
+    diagnosticsChange(modifier);
+    break;
+
   case MODE_OUTPUT_LIST:
     currentRow = currentRow + modifier;
     if (currentRow == 255)
@@ -263,17 +423,65 @@ void CmModel::handleRotary(bool increment)
 
 */
 
-void CmModel::prepareOutputSettingsChange()
+/*
+  Settings of output n as the UI sees them: its staged settings while it
+  has changes waiting for commit, otherwise those in use. Returns false if
+  the last submit for the output has not reached the tick yet.
+*/
+bool CmModel::loadOutputSettings(uint8_t n, OutputSettings &s)
+{
+  if (outputCommitPending(n))
+  {
+    if (outputStaged[n] != outputSubmitted[n])
+      return false;
+
+    s = stagedOutputs[n];
+  }
+  else
+  {
+    Output *o = outputs[n];
+    s.type = o->type;
+    s.clockLength = o->clockLength;
+    s.gateLength = o->gateLength;
+    s.startDelayLength = o->startDelayLength;
+    s.lfoPhaseOffset = o->lfoPhaseOffset;
+    s.lfoRate = o->lfoRate;
+    s.euclideanSteps = o->euclideanSteps;
+    s.euclideanRotation = o->euclideanRotation;
+    s.randomTriggerProbability = o->randomTriggerProbability;
+    s.sequenceLength = o->sequenceLength;
+    s.steps = o->steps;
+  }
+  return true;
+}
+
+/*
+  Load the settings page from the selected output. Returns false if the
+  last submit for the output has not reached the tick yet.
+*/
+bool CmModel::prepareOutputSettingsChange()
 {
-  currentOutput = currentRow;
+  uint8_t n = currentRow;
+  OutputSettings s;
+
+  if (!loadOutputSettings(n, s))
+    return false;
+
+  editType = s.type;
+  editClockLength = s.clockLength;
+  editGateLength = s.gateLength;
+  editStartDelayLength = s.startDelayLength;
+  editEuclideanSteps = s.euclideanSteps;
+  editEuclideanRotation = s.euclideanRotation;
+  editSequenceLength = s.sequenceLength;
+  editRandomTriggerProbability = s.randomTriggerProbability;
+  editLfoPhaseOffset = s.lfoPhaseOffset;
+  editLfoRate = s.lfoRate;
+  editSteps = s.steps;
+
+  currentOutput = n;
   currentRow = 0;
-  editType = outputs[currentOutput]->type;
-  editClockLength = outputs[currentOutput]->clockLength;
-  editGateLength = outputs[currentOutput]->gateLength;
-  editStartDelayLength = outputs[currentOutput]->startDelayLength;
-  editEuclideanSteps = outputs[currentOutput]->euclideanSteps;
-  editSequenceLength = outputs[currentOutput]->sequenceLength;
-  editRandomTriggerProbability = outputs[currentOutput]->randomTriggerProbability;
+  return true;
 }
 
 void CmModel::outputSettingsValueChange(int8_t modifier)
@@ -324,20 +532,35 @@ void CmModel::outputSettingsValueChangeEuclidean(int8_t modifier)
   {
   case 2:
     editSequenceLength = editSequenceLength + modifier;
-    if (editSequenceLength > MAX_EUCLIDEAN_LENGTH)
-      editSequenceLength = MAX_EUCLIDEAN_LENGTH;
-    if (editSequenceLength == 0)
-      editSequenceLength = 1;
     break;
   case 3:
     editEuclideanSteps = editEuclideanSteps + modifier;
-    if (editEuclideanSteps > MAX_EUCLIDEAN_LENGTH)
-      editEuclideanSteps = MAX_EUCLIDEAN_LENGTH;
-    if (editEuclideanSteps == 0)
-      editEuclideanSteps = 1;
+    break;
+  case 4:
+    /* Rotation, wraps around */
+    editEuclideanRotation = editEuclideanRotation + modifier;
+    if (editEuclideanRotation == 255)
+      editEuclideanRotation = editSequenceLength - 1;
+    else if (editEuclideanRotation >= editSequenceLength)
+      editEuclideanRotation = 0;
     break;
   }
-  editSequence = outputs[currentOutput]->generateTemporaryEuclideanSequence(editEuclideanSteps, editSequenceLength);
+
+  /*
+     Keep k and the rotation within the length, also when coming from
+     another type.
+  */
+  if (editSequenceLength > MAX_EUCLIDEAN_LENGTH)
+    editSequenceLength = MAX_EUCLIDEAN_LENGTH;
+  if (editSequenceLength == 0)
+    editSequenceLength = 1;
+  if (editEuclideanSteps > editSequenceLength)
+    editEuclideanSteps = editSequenceLength;
+  if (editEuclideanSteps == 0)
+    editEuclideanSteps = 1;
+  if (editEuclideanRotation >= editSequenceLength)
+    editEuclideanRotation = editSequenceLength - 1;
+  Output::loadEuclideanPattern(editEuclideanSteps, editSequenceLength, editSteps);
 }
 
 void CmModel::outputSettingsValueChangeRandomTriggers(int8_t modifier)
@@ -355,12 +578,11 @@ void CmModel::outputSettingsValueChangeRandomTriggers(int8_t modifier)
     editSequenceLength = editSequenceLength + modifier;
     if (editSequenceLength == 1)
       editSequenceLength = 2;
-    if (editSequenceLength > 32)
-      editSequenceLength = 32;
+    if (editSequenceLength > MAX_RANDOM_TRIGGER_LENGTH)
+      editSequenceLength = MAX_RANDOM_TRIGGER_LENGTH;
     break;
   }
-  editSequence = outputs[currentOutput]->generateTemporarySequence(RANDOM_TRIGGERS, editSequenceLength);
-  editSequenceB = outputs[currentOutput]->generateTemporarySequence(RANDOM_TRIGGERS, editSequenceLength);
+  generateRandomSteps(currentOutput, RANDOM_TRIGGERS, editSequenceLength, editRandomTriggerProbability, editSteps);
 }
 
 void CmModel::outputSettingsValueChangeVoltage(int8_t modifier)
@@ -375,7 +597,7 @@ void CmModel::outputSettingsValueChangeVoltage(int8_t modifier)
       editSequenceLength = MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH;
     break;
   }
-  editSequence = outputs[currentOutput]->generateTemporarySequence(VOLTAGE, editSequenceLength);
+  generateRandomSteps(currentOutput, VOLTAGE, editSequenceLength, 0, editSteps);
 }
 
 void CmModel::outputSettingsValueChangeGateSineSaw(int8_t modifier)
@@ -399,49 +621,168 @@ void CmModel::outputSettingsValueChangeGateSineSaw(int8_t modifier)
       editStartDelayLength = NUM_CLOCKS;
 
     break;
+  case 4:
+    /* LFO phase offset, wraps around */
+    editLfoPhaseOffset = editLfoPhaseOffset + modifier * LFO_PHASE_OFFSET_STEP;
+    break;
+  case 5:
+    /* LFO rate */
+    editLfoRate = editLfoRate + modifier;
+    if (editLfoRate == 255)
+      editLfoRate = 0;
+    if (editLfoRate >= NUM_LFO_RATES)
+      editLfoRate = NUM_LFO_RATES - 1;
+    break;
   }
 }
 
 /*
-  Commit output settings changes. To be called on 1st beat of a bar, i.e every 4th beat.
+  Random trigger (with probability in percent) or voltage sequence of len
+  steps for output n. With a seed set the sequence comes from a stream
+  started from the seed of the output, so the same seed and settings
+  always give the same sequence. Without one every call gives a new one.
 */
-void CmModel::commitOutputSettingsChange()
+void CmModel::generateRandomSteps(uint8_t n, uint8_t type, uint8_t len, uint8_t probability, StepBits &s)
 {
+  RandomStream seeded;
+  RandomStream &r = seed ? seeded : uiRandom;
+  if (seed)
+    seeded.seed(streamSeed(seed, n));
 
-  printFreeMem();
-
-  // Set output values
-  outputChangesReadyForCommit = false;
+  s.clear();
+  if (type == VOLTAGE)
+  {
+    if (len > 0)
+      Output::generateRandomVoltageSequence(r, s);
+  }
+  else if (type == RANDOM_TRIGGERS)
+  {
+    if (len > MAX_RANDOM_TRIGGER_LENGTH)
+      len = MAX_RANDOM_TRIGGER_LENGTH;
+    Output::generateRandomTriggerSequence(r, probability, len, s);
+  }
+}
 
-  Output *o = outputs[currentOutput];
+/*
+  Stage the settings page values of the current output in the tick. They
+  wait there, with those of other outputs, for commitStagedOutputs().
+*/
+void CmModel::submitOutputSettingsChange()
+{
+  OutputSettings s;
 
   if (editType == EUCLIDEAN || editType == RANDOM_TRIGGERS)
     editGateLength = CLOCK_1x128;
 
-  o->setOutputType(editType);
-  o->setClockLength(editClockLength);
-  o->setGateLength(editGateLength);
-  if (editType != VOLTAGE)
-    o->setStartDelayLength(editStartDelayLength);
-  if (editType == EUCLIDEAN)
+  s.type = editType;
+  s.clockLength = editClockLength;
+  s.gateLength = editGateLength;
+  s.startDelayLength = editStartDelayLength;
+  s.lfoPhaseOffset = editLfoPhaseOffset;
+  s.lfoRate = editLfoRate;
+  s.euclideanSteps = editEuclideanSteps;
+  s.euclideanRotation = editEuclideanRotation;
+  s.randomTriggerProbability = editRandomTriggerProbability;
+  s.sequenceLength = editSequenceLength;
+  s.steps = editSteps;
+  submitOutputSettings(currentOutput, s);
+}
+
+void CmModel::submitOutputSettings(uint8_t n, const OutputSettings &s)
+{
+  Command c;
+  c.type = CMD_OUTPUT;
+  c.output = n;
+  c.serial = ++outputSubmitted[n];
+  c.settings = s;
+  outputArmedMask &= ~((OutputMask)1 << n);
+  pushCommand(c);
+}
+
+/*
+  Settings of output n for the next commitPreset(), see presetOutputs.
+  Only called while presetReady().
+*/
+void CmModel::submitPresetOutput(uint8_t n, const OutputSettings &s)
+{
+  presetOutputs[n] = s;
+  presetSerial[n] = ++outputSubmitted[n];
+  presetMask |= (OutputMask)1 << n;
+  outputArmedMask &= ~((OutputMask)1 << n);
+}
+
+/*
+  Send the outputs submitted since the last CMD_PRESET with c, which has
+  everything but the mask filled in.
+*/
+void CmModel::pushPreset(Command &c)
+{
+  c.type = CMD_PRESET;
+  c.preset.mask = presetMask;
+  presetMask = 0;
+  presetPending = true;
+  pushCommand(c);
+}
+
+void CmModel::applyOutputSettings(uint8_t n, const OutputSettings &s)
+{
+
+  printFreeMem();
+
+  Output *o = outputs[n];
+
+  o->setOutputType(s.type);
+  o->setClockLength(s.clockLength);
+  o->setLfoRate(s.type == SAW || s.type == SAW_INVERTED || s.type == SINE ? s.lfoRate : LFO_RATE_X1);
+  o->setGateLength(s.gateLength);
+  if (s.type != VOLTAGE)
+    o->setStartDelayLength(s.startDelayLength);
+  if (s.type == SAW || s.type == SAW_INVERTED || s.type == SINE)
+    o->setLfoPhaseOffset(s.lfoPhaseOffset);
+  if (s.type == EUCLIDEAN)
   {
-    o->setEuclideanSteps(editEuclideanSteps);
+    o->setEuclideanSteps(s.euclideanSteps);
+    o->setEuclideanRotation(s.euclideanRotation);
   }
-  else if (editType == RANDOM_TRIGGERS)
-    o->setRandomTriggerProbability(editRandomTriggerProbability);
-  if (editType == EUCLIDEAN || editType == VOLTAGE)
+  else if (s.type == RANDOM_TRIGGERS)
+    o->setRandomTriggerProbability(s.randomTriggerProbability);
+  if (s.type == EUCLIDEAN || s.type == RANDOM_TRIGGERS || s.type == VOLTAGE)
   {
-    o->setSequence(editSequence);
-    o->setSequenceLength(editSequenceLength);
+    o->setSequence(s.steps);
+    o->setSequenceLength(s.sequenceLength);
   }
-  else if (editType == RANDOM_TRIGGERS)
+
+}
+
+/*
+  Commit all staged output settings together on the next quantum
+  boundary. Returns false if no output has uncommitted changes.
+*/
+bool CmModel::commitStagedOutputs()
+{
+  OutputMask pending = 0;
+  bool uncommitted = false;
+
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
   {
-    o->setSequence(editSequence, editSequenceB);
-    o->setSequenceLength(editSequenceLength);
+    if (outputCommitPending(i))
+    {
+      pending |= (OutputMask)1 << i;
+      if (!outputCommitArmed(i))
+        uncommitted = true;
+    }
   }
 
-  resetOutput(o);
-  renderView = true;
+  if (!uncommitted)
+    return false;
+
+  outputArmedMask = pending;
+
+  Command c;
+  c.type = CMD_COMMIT;
+  c.quantum = 0;
+  pushCommand(c);
+  return true;
 }
 
 /***********************************************
@@ -455,10 +796,71 @@ void CmModel::bpmChange(int8_t modifier)
   BPM = BPM + modifier;
   if (BPM < MIN_BPM)
     BPM = MIN_BPM;
-  else if (BPM > MAX_BPM)
+  else if (BPM >= MAX_BPM)
+  {
     BPM = MAX_BPM;
-  CmHardware *hw = CmHardware::getInstance();
-  hw->updateOCR1A_limit();
+    bpmFraction = 0;
+  }
+  if (!syncActive)
+    updateClockPeriod();
+}
+
+void CmModel::bpmFineChange(int8_t modifier)
+{
+  bpmFraction = bpmFraction + modifier;
+  if (bpmFraction == 255)
+  {
+    if (BPM > MIN_BPM)
+    {
+      BPM--;
+      bpmFraction = BPM_FRACTION_STEPS - 1;
+    }
+    else
+      bpmFraction = 0;
+  }
+  else if (bpmFraction == BPM_FRACTION_STEPS)
+  {
+    BPM++;
+    bpmFraction = 0;
+  }
+  if (BPM >= MAX_BPM)
+  {
+    BPM = MAX_BPM;
+    bpmFraction = 0;
+  }
+  if (!syncActive)
+    updateClockPeriod();
+}
+
+/*
+  Timer1 period for current tempo, in integer math. When the period is a
+  whole number of timer ticks the tick never touches the compare register.
+  Takes effect from the next tick.
+*/
+void CmModel::updateClockPeriod()
+{
+  pushTempo(CMD_TEMPO);
+}
+
+/*
+  Send the current tempo as CMD_TEMPO, or as CMD_STAGE_TEMPO to take
+  effect with the next commit.
+*/
+void CmModel::pushTempo(uint8_t type)
+{
+  Command c;
+  c.type = type;
+  tempoSettings(c.tempo);
+  pushCommand(c);
+}
+
+void CmModel::tempoSettings(TempoSettings &t)
+{
+  uint16_t centiBpm = BPM * BPM_FRACTION_STEPS + bpmFraction;
+
+  t.period = TIMER1_TICKS_PER_CENTIBPM / centiBpm;
+  t.remainder = TIMER1_TICKS_PER_CENTIBPM % centiBpm;
+  t.divisor = centiBpm;
 }
 
 void CmModel::swingChange(int8_t modifier)
@@ -468,15 +870,664 @@ void CmModel::swingChange(int8_t modifier)
     swing = 0;
   else if (swing > MAX_SWING)
     swing = MAX_SWING;
-  updateSwingTable();
-  swingChangeReadyForCommit = true;
+
+  Command c;
+  c.type = CMD_SWING;
+  c.swing = swing;
+  pushCommand(c);
+}
+
+/***********************************************
+
+  PRESETS
+
+*/
+
+void CmModel::presetChange(int8_t modifier)
+{
+  presetAction = presetAction + modifier;
+  if (presetAction == 255)
+    presetAction = 0;
+  else if (presetAction >= PRESET_ACTIONS)
+    presetAction = PRESET_ACTIONS - 1;
+  presetStatus = PRESET_IDLE;
+}
+
+/*
+  Load or save the slot selected on the preset page
+*/
+void CmModel::presetRun()
+{
+  CmPreset *preset = CmPreset::getInstance();
+  uint8_t slot = presetAction % NUM_PRESETS;
+
+  if (presetAction < NUM_PRESETS)
+    presetStatus = preset->recall(slot) ? PRESET_LOADED : PRESET_EMPTY;
+  else
+    presetStatus = preset->save(slot) ? PRESET_SAVING : PRESET_BUSY;
+}
+
+/*
+  Take over tempo, swing and the output settings submitted by a preset
+  recall together on the next bar, as one CMD_PRESET. Tempo is left
+  alone while following the external clock.
+*/
+void CmModel::commitPreset(byte bpm, byte fraction, byte s, uint16_t seed)
+{
+  Command c;
+
+  c.preset.tempoSet = false;
+  if (bpm >= MIN_BPM && bpm <= MAX_BPM && fraction < BPM_FRACTION_STEPS)
+  {
+    BPM = bpm;
+    bpmFraction = bpm == MAX_BPM ? 0 : fraction;
+    if (!syncActive)
+    {
+      c.preset.tempoSet = true;
+      tempoSettings(c.preset.tempo);
+    }
+  }
+
+  swing = s > MAX_SWING ? MAX_SWING : s;
+  c.preset.swingSet = true;
+  c.preset.swing = swing;
+  c.preset.seed = seed;
+  c.preset.quantum = PPQN_BAR;
+  outputArmedMask = ~(OutputMask)0;
+  pushPreset(c);
+}
+
+/***********************************************
+
+  RANDOM SEED
+
+*/
+
+void CmModel::seedChange(int8_t modifier)
+{
+  editSeed = editSeed + modifier;
+  if (editSeed == 0xFFFF)
+    editSeed = 0;
+  else if (editSeed > MAX_RANDOM_SEED)
+    editSeed = MAX_RANDOM_SEED;
+}
+
+void CmModel::diagnosticsChange(int8_t modifier)
+{
+  diagnosticsKind = diagnosticsKind + modifier;
+  if (diagnosticsKind == 255)
+    diagnosticsKind = 0;
+  else if (diagnosticsKind >= NUM_TICK_KINDS)
+    diagnosticsKind = NUM_TICK_KINDS - 1;
+}
+
+/*
+  Take the seed selected on the seed page into use. Random sequences are
+  generated again from it and all outputs restart on the current quantum,
+  so a seed always gives the same patterns from there on.
+*/
+void CmModel::seedRun()
+{
+  OutputSettings s;
+
+  if (!presetReady())
+    return;
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    if (outputCommitPending(i) && outputStaged[i] != outputSubmitted[i])
+      return;
+  }
+
+  seed = editSeed;
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    loadOutputSettings(i, s);
+    if ((s.type == RANDOM_TRIGGERS || s.type == VOLTAGE) && s.sequenceLength > 0)
+    {
+      generateRandomSteps(i, s.type, s.sequenceLength, s.randomTriggerProbability, s.steps);
+      submitPresetOutput(i, s);
+    }
+  }
+
+  Command c;
+  c.preset.tempoSet = false;
+  c.preset.swingSet = false;
+  c.preset.seed = seed;
+  c.preset.quantum = 0;
+  outputArmedMask = ~(OutputMask)0;
+  pushPreset(c);
+  viewChanged = true;
+}
+
+void CmModel::quantumChange(int8_t modifier)
+{
+  quantum = quantum + modifier;
+  if (quantum == 255)
+    quantum = 0;
+  else if (quantum >= NUM_QUANTUMS)
+    quantum = NUM_QUANTUMS - 1;
+
+  Command c;
+  c.type = CMD_QUANTUM;
+  c.quantum = QUANTUM_TO_PPQN[quantum];
+  pushCommand(c);
+}
+
+/***********************************************
+
+  UI TO TICK COMMANDS
+
+*/
+
+/*
+  Queue a command for the tick. The Timer1 interrupt empties the queue
+  every time it runs, whether the clock runs or not, and a preset recall
+  takes a single slot, so it only fills up if the UI gets more than
+  COMMAND_QUEUE_SIZE changes ahead of the interrupt. Then waiting here is
+  bounded by one Timer1 period (at most 32 ms with TICKLESS) and no
+  change is dropped.
+*/
+void CmModel::pushCommand(const Command &c)
+{
+  while (!commands.push(c))
+    ;
+}
+
+/*
+  Start/stop from the main loop. Only changes are sent.
+*/
+void CmModel::setRunning(bool running)
+{
+  if (running == runRequested)
+    return;
+  runRequested = running;
+
+  Command c;
+  c.type = running ? CMD_START : CMD_STOP;
+  pushCommand(c);
+}
+
+/*
+  Consumer side of the command queue, at a tick boundary. Tempo, quantum
+  and start/stop apply at once. Output settings, preset tempo and seed
+  are staged until a commit and swing until the next quantum boundary, or
+  applied at once when the clock is stopped.
+*/
+void CmModel::processCommands()
+{
+  Command c;
+
+  while (commands.pop(c))
+  {
+    switch (c.type)
+    {
+    case CMD_TEMPO:
+      applyTempo(c.tempo);
+      break;
+
+    case CMD_STAGE_TEMPO:
+      stagedTempo = true;
+      stagedTempoValue = c.tempo;
+      break;
+
+    case CMD_SEED:
+      stagedSeed = true;
+      stagedSeedValue = c.seed;
+      break;
+
+    case CMD_SWING:
+      stagedSwing = true;
+      stagedSwingValue = c.swing;
+      commitTimeSet = false;
+      break;
+
+    case CMD_OUTPUT:
+      stageOutput(c.output, c.settings, c.serial);
+      break;
+
+    case CMD_PRESET:
+      for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+      {
+        if (c.preset.mask & ((OutputMask)1 << i))
+          stageOutput(i, presetOutputs[i], presetSerial[i]);
+      }
+      COMMAND_BARRIER();
+      presetPending = false;
+      if (c.preset.tempoSet)
+      {
+        stagedTempo = true;
+        stagedTempoValue = c.preset.tempo;
+      }
+      if (c.preset.swingSet)
+      {
+        stagedSwing = true;
+        stagedSwingValue = c.preset.swing;
+      }
+      stagedSeed = true;
+      stagedSeedValue = c.preset.seed;
+      commitArmed = true;
+      armedQuantum = c.preset.quantum;
+      armedCounter = interruptCounter;
+      commitTimeSet = false;
+      break;
+
+    case CMD_COMMIT:
+      commitArmed = true;
+      armedQuantum = c.quantum;
+      armedCounter = interruptCounter;
+      commitTimeSet = false;
+      break;
+
+    case CMD_QUANTUM:
+      commitQuantum = c.quantum;
+      commitTimeSet = false;
+      break;
+
+    case CMD_START:
+      /* Changes received while stopped apply before the first tick */
+      commitStagedChanges();
+      clockRunning = true;
+      break;
+
+    case CMD_STOP:
+      clockRunning = false;
+      clockStopped();
+      break;
+    }
+  }
+
   if (!clockRunning)
-    commitSwingChange();
+    commitStagedChanges();
 }
 
-void CmModel::commitSwingChange()
+void CmModel::stageOutput(uint8_t n, const OutputSettings &s, uint8_t serial)
 {
-  swingChangeReadyForCommit = false;
-  resetOutputs();
+  stagedOutputs[n] = s;
+  stagedSerial[n] = serial;
+  stagedOutputMask |= (OutputMask)1 << n;
+  outputStaged[n] = serial;
+}
+
+void CmModel::applyTempo(const TempoSettings &t)
+{
+  clockPeriod = t.period;
+  clockRemainder = t.remainder;
+  clockDivisor = t.divisor;
+  clockError = 0;
+  clockPeriodChanged = true;
+}
+
+/*
+  Apply staged swing, and staged output settings, tempo and seed if committed,
+  in one step. Bounded by one settings update and reset per output plus a single
+  port update, whatever the number of outputs changed.
+*/
+void CmModel::commitStagedChanges()
+{
+  uint16_t start = halTimerCount();
+  OutputMask reset = 0;
+
+  if (stagedSwing)
+  {
+    stagedSwing = false;
+    updateSwingTable(stagedSwingValue);
+    reset = ~(OutputMask)0;
+  }
+
+  if (commitArmed)
+  {
+    commitArmed = false;
+    commitWaitTicks = interruptCounter - armedCounter;
+    if (stagedTempo)
+    {
+      stagedTempo = false;
+      applyTempo(stagedTempoValue);
+    }
+    if (stagedSeed)
+    {
+      stagedSeed = false;
+      for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+      {
+        outputs[i]->setRandomSeed(stagedSeedValue ? streamSeed(stagedSeedValue, i) : 0);
+      }
+      reset = ~(OutputMask)0;
+    }
+    for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+    {
+      if (stagedOutputMask & ((OutputMask)1 << i))
+      {
+        applyOutputSettings(i, stagedOutputs[i]);
+        outputCommitted[i] = stagedSerial[i];
+      }
+    }
+    reset |= stagedOutputMask;
+    stagedOutputMask = 0;
+  }
+
+  if (!reset)
+    return;
+
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    if (reset & ((OutputMask)1 << i))
+      resetOutput(i);
+  }
+  updateOutputPorts(reset);
   renderView = true;
+
+  uint16_t elapsed = halTimerCount() - start;
+  if (elapsed > commitTimerTicksMax)
+    commitTimerTicksMax = elapsed;
+}
+
+/***********************************************
+
+  EXTERNAL CLOCK SYNC
+
+*/
+
+/*
+  Rising edge on the clock input, called from the pin change interrupt.
+  The pulse interval is averaged to filter jitter, and the Timer1 period is
+  set so that the next SYNC_TICKS_PER_PULSE ticks fill the interval. Phase
+  error against the pulse is corrected by half on every pulse.
+*/
+void CmModel::syncPulse(uint32_t now)
+{
+  uint32_t interval = now - syncLastPulseMicros;
+  syncLastPulseMicros = now;
+
+  if (interval < SYNC_MIN_INTERVAL_MICROS || interval > SYNC_MAX_INTERVAL_MICROS)
+  {
+    syncPulseCount = 0;
+    return;
+  }
+
+  if (syncPulseCount == 0)
+    syncIntervalMicros = interval;
+  else
+    syncIntervalMicros += ((int32_t)interval - (int32_t)syncIntervalMicros) >> SYNC_FILTER_SHIFT;
+
+  if (syncPulseCount < SYNC_LOCK_PULSES)
+  {
+    syncPulseCount++;
+    return;
+  }
+
+  if (!syncActive)
+  {
+    syncActive = true;
+    renderView = true;
+  }
+
+  /* Phase error in PPQN ticks, positive when running ahead of the pulses */
+  int8_t phaseError = interruptCounter % SYNC_TICKS_PER_PULSE;
+  if (phaseError >= SYNC_TICKS_PER_PULSE / 2)
+    phaseError -= SYNC_TICKS_PER_PULSE;
+
+  int32_t pulseTimerTicks = syncIntervalMicros * (CPU_FREQ / PRESCALER / 1000000);
+  pulseTimerTicks += pulseTimerTicks / (2 * SYNC_TICKS_PER_PULSE) * phaseError;
+
+  clockPeriod = pulseTimerTicks / SYNC_TICKS_PER_PULSE;
+  clockRemainder = pulseTimerTicks % SYNC_TICKS_PER_PULSE;
+  clockDivisor = SYNC_TICKS_PER_PULSE;
+  clockError = 0;
+  clockPeriodChanged = true;
+}
+
+/*
+  Called from the main loop. Falls back to the internal tempo when pulses
+  stop.
+*/
+void CmModel::syncCheckTimeout(uint32_t now)
+{
+  if (!syncActive)
+    return;
+
+  noInterrupts();
+  uint32_t lastPulse = syncLastPulseMicros;
+  interrupts();
+
+  if (now - lastPulse > SYNC_TIMEOUT_MICROS)
+  {
+    syncActive = false;
+    syncPulseCount = 0;
+    updateClockPeriod();
+    renderView = true;
+  }
+}
+
+/*
+  Detected external tempo in 1/100 BPM.
+*/
+uint16_t CmModel::syncCentiBpm()
+{
+  noInterrupts();
+  uint32_t interval = syncIntervalMicros;
+  interrupts();
+
+  if (interval == 0)
+    return 0;
+  return 60000000UL / SYNC_PULSES_PER_QUARTER * BPM_FRACTION_STEPS / interval;
+}
+
+/***********************************************
+
+  PPQN TICK
+
+*/
+
+/*
+  One PPQN tick. Called from the Timer1 interrupt on target and from the
+  host simulator, which drives it at virtual time.
+*/
+void CmModel::tick()
+{
+#if PROFILE_TICK
+  uint16_t start = halTimerCount();
+  uint8_t kind = NO_EVENT;
+#endif
+
+  processCommands();
+  if (!clockRunning)
+    return;
+
+  /*
+      Length of the tick that starts now: one timer tick longer whenever the
+      accumulated fraction of the period reaches a whole timer tick. Tickless
+      sets the period in scheduleWake() instead.
+  */
+  if (!TICKLESS && (clockRemainder || clockPeriodChanged))
+  {
+    clockPeriodChanged = false;
+    uint16_t period = clockPeriod;
+    clockError += clockRemainder;
+    if (clockError >= clockDivisor)
+    {
+      clockError -= clockDivisor;
+      period++;
+    }
+    halSetTimerCompare(period - 1);
+  }
+
+  /*
+      Update output states
+  */
+  halWriteGatePorts(gatePorts);
+
+  /*
+     Advance the PPQN/interrupt counter by the ticks since the last
+     interrupt. Kept in a register for the rest of the tick,
+     interruptCounter is only written back.
+  */
+  EventTime now = interruptCounter + wakeTicks;
+  interruptCounter = now;
+  bool portsChanged = false;
+
+  /*
+    Commit output/swing changes on the quantum boundary, or on the
+    quantum the commit was armed with. The boundary is worked out once,
+    on the first tick after a change, not with a 32-bit division per tick.
+  */
+  if (commitArmed || stagedSwing)
+  {
+    if (!commitTimeSet)
+    {
+      uint16_t q = commitArmed && armedQuantum ? armedQuantum : commitQuantum;
+      uint16_t r = now % q;
+      commitTime = r ? now + q - r : now;
+      commitTimeSet = true;
+    }
+    if (now == commitTime)
+    {
+      commitTimeSet = false;
+      commitStagedChanges();
+      portsChanged = true;
+#if PROFILE_TICK
+      kind = TICK_COMMIT;
+#endif
+    }
+  }
+
+  /*
+     Calculate new gate values for next cycle. Only outputs in the current
+     wheel slot can be due; the slot also holds events a multiple of
+     EVENT_WHEEL_SIZE ticks further away, which are left in place. An
+     output is only dereferenced once its event is due.
+  */
+  uint8_t slot = now & EVENT_WHEEL_MASK;
+  OutputMask due = eventWheel[slot];
+  bool pwmChanged = false;
+
+  for (uint8_t i = 0; due; i++, due >>= 1)
+  {
+
+    if (!(due & 1) || eventTime[i] != now)
+      continue;
+
+    eventWheel[slot] &= ~((OutputMask)1 << i);
+
+    Output *o = outputs[i];
+
+#if PROFILE_TICK
+    /* Event values are in order of cost, a commit beats all of them */
+    if (event[i] > kind)
+      kind = event[i];
+#endif
+
+    switch (event[i])
+    {
+
+    case GATE_CLOSE:
+      gatePorts[pgm_read_byte(&GATE_PORT[i])] &= ~pgm_read_byte(&GATE_BIT[i]);
+      portsChanged = true;
+      if (o->clockLength < CLOCK_LENGTH_SWINGABLE_LIMIT)
+        scheduleOutput(i, GATE_OPEN, o->nextSwingGateOpenTime(now, swingTable[o->clockLength]));
+      else
+        scheduleOutput(i, GATE_OPEN, o->nextGateOpenTime(now));
+      break;
+    case GATE_OPEN:
+      if (o->gateOpen)
+      {
+        gatePorts[pgm_read_byte(&GATE_PORT[i])] |= pgm_read_byte(&GATE_BIT[i]);
+        portsChanged = true;
+      }
+      scheduleOutput(i, GATE_CLOSE, o->nextGateCloseTime(now));
+      break;
+    case PWM_EVENT:
+      /* Only CV outputs (FIRST_PWM_OUTPUT..) can have PWM events */
+      pwmShadow[i - FIRST_PWM_OUTPUT] = o->pwm_out;
+      pwmChanged = true;
+      o->handlePwmEvent();
+      scheduleOutput(i, PWM_EVENT, now + PWM_EVENT_PPQN);
+      break;
+    }
+  }
+
+  if (pwmChanged)
+    halPwmLatch(pwmShadow);
+
+#if PROFILE_TICK
+  /* The period this tick runs in, before scheduleWake() sets the next */
+  uint16_t period = halTimerCompare() + 1;
+#endif
+
+  if (TICKLESS)
+    scheduleWake(now, portsChanged);
+
+#if PROFILE_TICK
+  /* TCNT1 has restarted from 0 if the tick overran its period */
+  bool overrun = halTimerOverrun();
+  uint16_t cost = halTimerCount() - start;
+  if (overrun)
+    cost += period;
+  tickProfile.record(kind, cost, overrun);
+#endif
+}
+
+/*
+  Tickless timer: set the Timer1 period to end on the next tick with work
+  to do, at most as many tick periods as fit in 16 bits (10 at 100 BPM).
+  That is the next tick when gates changed, as the ports are written at
+  its start, else the next output event or the next quantum boundary
+  while a commit or swing change waits. External sync needs every tick
+  from the second pulse on, for its phase error and its period updates.
+
+  The periods of the skipped ticks are added up with the same error
+  diffusion as one per tick, so events fall on the same Timer1 count and
+  tempo stays exact.
+*/
+void CmModel::scheduleWake(EventTime now, bool portsChanged)
+{
+  uint16_t wake = 255;
+
+  if (portsChanged || syncPulseCount)
+  {
+    wake = 1;
+  }
+  else
+  {
+    if ((commitArmed || stagedSwing) && commitTime - now < wake)
+      wake = commitTime - now;
+    for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+    {
+      EventTime d = eventTime[i] - now;
+      if (d && d < wake)
+        wake = d;
+    }
+  }
+
+  uint16_t period = 0;
+  uint8_t ticks = 0;
+  do
+  {
+    period += clockPeriod;
+    clockError += clockRemainder;
+    if (clockError >= clockDivisor)
+    {
+      clockError -= clockDivisor;
+      period++;
+    }
+    ticks++;
+  } while (ticks < wake && period < 0xFFFF - clockPeriod);
+
+  clockPeriodChanged = false;
+  wakeTicks = ticks;
+  halSetTimerCompare(period - 1);
+}
+
+#if PROFILE_TICK
+void CmModel::copyTickProfile(TickProfile &p)
+{
+  noInterrupts();
+  p = tickProfile;
+  interrupts();
+}
+
+void CmModel::clearTickProfile()
+{
+  noInterrupts();
+  tickProfile.clear();
+  interrupts();
 }
+#endif
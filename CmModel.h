@@ -4,15 +4,8 @@
 #include <Arduino.h>
 #include "Output.h"
 #include "Resources.h"
-
-static volatile Output o0(PIN_OUTPUT0, NO_ANALOG_OUTPUT);
-static volatile Output o1(PIN_OUTPUT1, NO_ANALOG_OUTPUT);
-static volatile Output o2(PIN_OUTPUT2, NO_ANALOG_OUTPUT);
-static volatile Output o3(PIN_OUTPUT3, NO_ANALOG_OUTPUT);
-static volatile Output o4(PIN_OUTPUT4, PIN_ANALOG4);
-static volatile Output o5(PIN_OUTPUT5, PIN_ANALOG5);
-static volatile Output o6(PIN_OUTPUT6, PIN_ANALOG6);
-static volatile Output o7(PIN_OUTPUT7, PIN_ANALOG7);
+#include "CmCommand.h"
+#include "TickProfile.h"
 
 class CmModel
 {
@@ -22,17 +15,87 @@ private:
   CmModel(CmModel const &);        // copy disabled
   void operator=(CmModel const &); // assigment disabled
 
+  /*
+     UI to tick interrupt handoff. outputSubmitted counts settings sent per
+     output by the UI, outputStaged the count received by the tick and
+     outputCommitted the count applied. staged* are written by the tick
+     only: output settings wait there until a commit, swing until the next
+     quantum boundary. stagedOutputs[n] is also read by the UI once
+     outputStaged[n] has caught up, as the tick won't touch it again
+     before the next submit.
+  */
+  CommandQueue commands;
+  bool runRequested = false;
+  uint8_t outputSubmitted[NUM_OUTPUTS];
+  OutputMask outputArmedMask = 0; /* Pending outputs the UI has committed */
+  volatile uint8_t outputStaged[NUM_OUTPUTS];
+  volatile uint8_t outputCommitted[NUM_OUTPUTS];
+  OutputSettings stagedOutputs[NUM_OUTPUTS];
+  uint8_t stagedSerial[NUM_OUTPUTS];
+  OutputMask stagedOutputMask = 0;
+  bool stagedSwing = false;
+  uint8_t stagedSwingValue;
+  bool commitArmed = false;
+  uint16_t commitQuantum;
+  uint16_t armedQuantum; /* Quantum of the armed commit, 0 for commitQuantum */
+  EventTime armedCounter; /* interruptCounter when the commit was armed */
+  EventTime commitTime;   /* Quantum boundary of the staged changes ...   */
+  bool commitTimeSet = false; /* ... once the tick has worked it out      */
+  bool stagedTempo = false;
+  TempoSettings stagedTempoValue;
+  bool stagedSeed = false;
+  uint16_t stagedSeedValue;
+
+  /*
+     Output settings of the next CMD_PRESET, too big for the queue. The
+     UI fills them for the outputs in presetMask while presetPending is
+     false; from the push of the command until the tick has copied them
+     to stagedOutputs and cleared presetPending they are the tick's.
+  */
+  OutputSettings presetOutputs[NUM_OUTPUTS];
+  uint8_t presetSerial[NUM_OUTPUTS];
+  OutputMask presetMask = 0;
+  volatile bool presetPending = false;
+
+  uint32_t entropy; /* Power-up seed, used while seed is 0 */
+
+#if PROFILE_TICK
+  TickProfile tickProfile; /* Written by the tick only */
+#endif
+
   /* Private methods */
-  void updateSwingTable();
+  void pushCommand(const Command &c);
+  void pushTempo(uint8_t type);
+  void tempoSettings(TempoSettings &t);
+  void pushPreset(Command &c);
+  void stageOutput(uint8_t n, const OutputSettings &s, uint8_t serial);
+  void applyTempo(const TempoSettings &t);
+  void commitStagedChanges();
+  void applyOutputSettings(uint8_t n, const OutputSettings &s);
+  void updateSwingTable(uint8_t s);
   void resetOutputs();
-  void resetOutput(Output *o);
+  void resetOutput(uint8_t n);
+  void updateOutputPorts(OutputMask reset);
+  void scheduleWake(EventTime now, bool portsChanged);
+  void scheduleOutput(uint8_t n, uint8_t e, EventTime t)
+  {
+    event[n] = e;
+    eventTime[n] = t;
+    eventWheel[t & EVENT_WHEEL_MASK] |= (OutputMask)1 << n;
+  };
+  void unscheduleOutput(uint8_t n)
+  {
+    eventWheel[eventTime[n] & EVENT_WHEEL_MASK] &= ~((OutputMask)1 << n);
+  };
   void setupDefaultOutputs();
   void resetInterruptCounter()
   {
     interruptCounter = 0;
+    commitTimeSet = false;
   };
 
-  void prepareOutputSettingsChange();
+  bool loadOutputSettings(uint8_t n, OutputSettings &s);
+  bool prepareOutputSettingsChange();
   void outputSettingsValueChange(int8_t modifier);
   void outputSettingsValueChangeEuclidean(int8_t modifier);
   void outputSettingsValueChangeRandomTriggers(int8_t modifier);
@@ -40,21 +103,86 @@ private:
   void outputSettingsValueChangeGateSineSaw(int8_t modifier);
 
   void bpmChange(int8_t modifier);
+  void bpmFineChange(int8_t modifier);
   void swingChange(int8_t modifier);
+  void quantumChange(int8_t modifier);
+  void presetChange(int8_t modifier);
+  void presetRun();
+  void seedChange(int8_t modifier);
+  void seedRun();
+  void diagnosticsChange(int8_t modifier);
 
 public:
-  volatile int interruptCounter = 0;
+  /*
+     PPQN ticks since the clock started. Wraps after 2^32 ticks, 77 days
+     at MAX_BPM; events stay right across the wrap, quantum boundaries
+     move by the remainder of 2^32 by the quantum.
+  */
+  volatile EventTime interruptCounter = 0;
 
-  volatile Output *outputs[NUM_OUTPUTS];
+  /*
+     Output settings and per-type state, read by the tick only when an
+     output has an event due
+  */
+  Output *outputs[NUM_OUTPUTS];
+
+  /*
+     Scheduler state, touched on every tick. Kept in arrays of its own
+     rather than in Output, so the tick tests due times and sets gate
+     bits without dereferencing an output. Written by the tick only, or
+     before the Timer1 interrupt runs, so none of it is volatile.
+  */
+
+  /* Next event of each output and its interruptCounter time */
+  uint8_t event[NUM_OUTPUTS];
+  EventTime eventTime[NUM_OUTPUTS];
+
+  /* Gate levels by port, written to the ports on every tick */
+  uint8_t gatePorts[NUM_GATE_PORTS];
+
+  /* pwm_out of CV outputs, latched to the compare registers together */
+  uint8_t pwmShadow[NUM_PWM_OUTPUTS];
+
+  /* Outputs with a pending event, by eventTime modulo EVENT_WHEEL_SIZE */
+  OutputMask eventWheel[EVENT_WHEEL_SIZE];
+
+  /* PPQN ticks in the Timer1 period running now, 1 unless TICKLESS */
+  uint8_t wakeTicks = 1;
+
+  bool gateLevel(uint8_t n)
+  {
+    return gatePorts[pgm_read_byte(&GATE_PORT[n])] & pgm_read_byte(&GATE_BIT[n]);
+  }
 
   byte BPM;
+  byte bpmFraction; /* 1/100 BPM */
+
+  /*
+    Master clock. One PPQN tick is clockPeriod + clockRemainder / clockDivisor
+    Timer1 ticks; the fraction is spread over ticks by error diffusion.
+  */
+  volatile uint16_t clockPeriod;
+  volatile uint16_t clockRemainder;
+  volatile uint16_t clockDivisor;
+  volatile uint16_t clockError = 0;
+  volatile bool clockPeriodChanged = false;
+
+  /* External clock sync */
+  volatile bool syncActive = false;
+  volatile uint32_t syncLastPulseMicros = 0;
+  volatile uint32_t syncIntervalMicros = 0; /* Filtered pulse interval */
+  volatile uint8_t syncPulseCount = 0;
   byte swing;
   volatile byte swingTable[6];
+  uint8_t quantum; /* Commit quantum, Quantum */
 
-  volatile bool clockRunning = false;
+  /* Longest staged commit in the tick, in Timer1 counts (0.5 us) */
+  volatile uint16_t commitTimerTicksMax = 0;
 
-  volatile bool outputChangesReadyForCommit = false;
-  volatile bool swingChangeReadyForCommit = false;
+  /* Ticks the last commit waited for its quantum boundary */
+  volatile uint16_t commitWaitTicks = 0;
+
+  volatile bool clockRunning = false;
 
   /* Display data: one view, multiple pages */
   uint8_t currentMode;
@@ -65,15 +193,26 @@ public:
 
   volatile bool renderView = false;
 
+  uint8_t presetAction = 0; /* Preset page selection, see PRESET_ACTIONS */
+  uint8_t presetStatus = PRESET_IDLE;
+
+  uint8_t diagnosticsKind = 0; /* Diagnostics page, tick kind shown */
+
+  uint16_t seed = 0;     /* Random seed in use, 0 for power-up entropy */
+  uint16_t editSeed = 0; /* Seed page selection */
+  RandomStream uiRandom; /* Sequences while seed is 0, screensaver */
+
   uint8_t editType = 0;
   uint8_t editClockLength = 0;
   uint8_t editGateLength = 0;
   uint8_t editStartDelayLength = 0;
-  int editSequence = 0;
-  int editSequenceB = 0;
+  StepBits editSteps;
   byte editRandomTriggerProbability = 0;
   byte editEuclideanSteps = 0;
+  byte editEuclideanRotation = 0;
   byte editSequenceLength = 0;
+  uint8_t editLfoPhaseOffset = 0;
+  uint8_t editLfoRate = LFO_RATE_X1;
 
   // Static method to get the instance
   static CmModel *getInstance()
@@ -87,10 +226,62 @@ public:
 
   void handleButton();
   void handleButtonLongPress();
-  void handleRotary(bool increment);
+  void handleRotary(bool increment, bool held = false);
+
+  void submitOutputSettingsChange();
+  void submitOutputSettings(uint8_t n, const OutputSettings &s);
+  void submitPresetOutput(uint8_t n, const OutputSettings &s);
+  void commitPreset(byte bpm, byte fraction, byte s, uint16_t seed);
+
+  /*
+     False while the tick has not taken the last preset recall or seed
+     yet, presetOutputs can't be written then
+  */
+  bool presetReady()
+  {
+    return !presetPending;
+  }
+
+  void generateRandomSteps(uint8_t n, uint8_t type, uint8_t len, uint8_t probability, StepBits &s);
+  bool commitStagedOutputs();
+  void setRunning(bool running);
 
-  void commitOutputSettingsChange();
-  void commitSwingChange();
+  /*
+     True while settings sent for output n have not been applied yet
+  */
+  bool outputCommitPending(uint8_t n)
+  {
+    return outputSubmitted[n] != outputCommitted[n];
+  }
+
+  /*
+     True while output n is pending and committed, waiting for the quantum
+  */
+  bool outputCommitArmed(uint8_t n)
+  {
+    return outputCommitPending(n) && (outputArmedMask & ((OutputMask)1 << n));
+  }
+
+  /*
+     Apply queued commands. Called at the start of every tick, and by the
+     host tools in place of the Timer1 interrupt.
+  */
+  void processCommands();
+
+  void updateClockPeriod();
+  void syncPulse(uint32_t now);
+  void syncCheckTimeout(uint32_t now);
+  uint16_t syncCentiBpm();
+  void tick();
+
+#if PROFILE_TICK
+  /*
+     Consistent copy of the tick statistics, and starting them over.
+     Interrupts are off for the length of the copy.
+  */
+  void copyTickProfile(TickProfile &p);
+  void clearTickProfile();
+#endif
 };
 
 #endif
@@ -0,0 +1,268 @@
+#include "CmPreset.h"
+
+/* NUM_CLOCKS comes from the ClockLength enum, so not an #if */
+static_assert(NUM_CLOCKS <= 31 && NUM_TYPES <= 8, "Output type and clock length no longer fit one preset byte");
+
+CmPreset::CmPreset()
+{
+  for (uint8_t i = 0; i < NUM_PRESETS; i++)
+  {
+    slotRecord[i] = NO_RECORD;
+    slotSerial[i] = 0;
+  }
+}
+
+/*
+   Find the latest record of each slot and recall the newest one, so the
+   module starts up as it was last saved.
+*/
+void CmPreset::initialize()
+{
+  uint8_t record[PRESET_RECORD_SIZE];
+  uint8_t newestSlot = 0;
+
+  for (uint8_t r = 0; r < PRESET_JOURNAL_RECORDS; r++)
+  {
+    if (!readRecord(r, record))
+      continue;
+
+    uint16_t serial = record[0] | record[1] << 8;
+    uint8_t slot = record[2];
+
+    if (slotRecord[slot] == NO_RECORD || (int16_t)(serial - slotSerial[slot]) > 0)
+    {
+      slotRecord[slot] = r;
+      slotSerial[slot] = serial;
+    }
+    if (newestRecord == NO_RECORD || (int16_t)(serial - nextSerial) >= 0)
+    {
+      newestRecord = r;
+      newestSlot = slot;
+      nextSerial = serial + 1;
+    }
+  }
+
+  if (newestRecord != NO_RECORD)
+    recall(newestSlot);
+}
+
+uint8_t CmPreset::checksum(const uint8_t *record)
+{
+  uint8_t sum = 0;
+  for (uint8_t i = 0; i < PRESET_RECORD_SIZE - 1; i++)
+    sum += record[i];
+  return ~sum;
+}
+
+/*
+   Read journal record r, returns false if it is empty or incomplete
+*/
+bool CmPreset::readRecord(uint8_t r, uint8_t *record)
+{
+  uint16_t address = recordAddress(r);
+  for (uint8_t i = 0; i < PRESET_RECORD_SIZE; i++)
+    record[i] = halEepromRead(address + i);
+
+  return record[2] < NUM_PRESETS && record[PRESET_RECORD_SIZE - 1] == checksum(record);
+}
+
+/*
+   Output settings in PRESET_OUTPUT_SIZE bytes: type and clock length,
+   gate length, start delay, and up to three type specific values. The
+   LFO rate is stored relative to x1, so records from before it was added
+   recall at x1.
+   Sequences are not stored, Euclidean patterns are looked up again and
+   random patterns generated again on recall: the same ones if the preset
+   was saved with a seed, new ones if not.
+*/
+void CmPreset::packOutput(uint8_t n, uint8_t *p)
+{
+  Output *o = model->outputs[n];
+
+  p[0] = o->type << 5 | o->clockLength;
+  p[1] = o->gateLength;
+  p[2] = o->startDelayLength;
+  p[3] = 0;
+  p[4] = 0;
+  p[5] = 0;
+
+  switch (o->type)
+  {
+  case SAW:
+  case SAW_INVERTED:
+  case SINE:
+    p[3] = o->lfoPhaseOffset;
+    p[4] = o->lfoRate - LFO_RATE_X1;
+    break;
+  case EUCLIDEAN:
+    p[3] = o->sequenceLength;
+    p[4] = o->euclideanSteps;
+    p[5] = o->euclideanRotation;
+    break;
+  case RANDOM_TRIGGERS:
+    p[3] = o->sequenceLength;
+    p[4] = o->randomTriggerProbability;
+    break;
+  case VOLTAGE:
+    p[3] = o->sequenceLength;
+    break;
+  }
+}
+
+static uint8_t limit(uint8_t v, uint8_t low, uint8_t high)
+{
+  if (v < low)
+    return low;
+  if (v > high)
+    return high;
+  return v;
+}
+
+/*
+   The checksum only catches some corruption, so every field is brought
+   into the range the settings page allows before it is used: clock
+   lengths index CLOCK_LENGTH_TO_PPQN and sequence lengths the StepBits.
+*/
+void CmPreset::unpackOutput(uint8_t n, const uint8_t *p)
+{
+  OutputSettings s;
+
+  s.type = p[0] >> 5;
+  s.clockLength = limit(p[0] & 0x1F, 1, NUM_CLOCKS);
+  s.gateLength = limit(p[1], 1, NUM_CLOCKS);
+  s.startDelayLength = limit(p[2], 0, NUM_CLOCKS);
+  s.lfoPhaseOffset = 0;
+  s.lfoRate = LFO_RATE_X1;
+  s.euclideanSteps = DEFAULT_EUCLIDEAN_STEPS;
+  s.euclideanRotation = 0;
+  s.randomTriggerProbability = DEFAULT_RANDOM_TRIGGER_PROBABILITY;
+  s.sequenceLength = 0;
+  s.steps.clear();
+
+  if (s.type == NO_OUTPUT || (n < FIRST_PWM_OUTPUT && s.type > RANDOM_TRIGGERS))
+    s.type = CLOCK;
+
+  switch (s.type)
+  {
+  case SAW:
+  case SAW_INVERTED:
+  case SINE:
+    s.lfoPhaseOffset = p[3];
+    s.lfoRate = limit((uint8_t)(LFO_RATE_X1 + p[4]), 0, NUM_LFO_RATES - 1);
+    break;
+  case EUCLIDEAN:
+    s.sequenceLength = limit(p[3], 1, MAX_EUCLIDEAN_LENGTH);
+    s.euclideanSteps = limit(p[4], 1, s.sequenceLength);
+    s.euclideanRotation = limit(p[5], 0, s.sequenceLength - 1);
+    Output::loadEuclideanPattern(s.euclideanSteps, s.sequenceLength, s.steps);
+    break;
+  case RANDOM_TRIGGERS:
+    s.sequenceLength = p[3] == 1 ? 2 : limit(p[3], 0, MAX_RANDOM_TRIGGER_LENGTH);
+    s.randomTriggerProbability = limit(p[4], 0, 100);
+    model->generateRandomSteps(n, RANDOM_TRIGGERS, s.sequenceLength, s.randomTriggerProbability, s.steps);
+    break;
+  case VOLTAGE:
+    s.sequenceLength = limit(p[3], 0, MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH);
+    model->generateRandomSteps(n, VOLTAGE, s.sequenceLength, 0, s.steps);
+    break;
+  }
+
+  model->submitPresetOutput(n, s);
+}
+
+/*
+   Start saving the current tempo, swing, seed and outputs to slot. The record
+   is written by update(). Returns false if a save is still in progress.
+*/
+bool CmPreset::save(uint8_t slot)
+{
+  if (saving())
+    return false;
+
+  uint8_t *record = writeBuffer;
+  record[0] = nextSerial & 0xFF;
+  record[1] = nextSerial >> 8;
+  record[2] = slot;
+  record[3] = model->BPM;
+  record[4] = model->bpmFraction;
+  record[5] = model->swing;
+  record[6] = model->seed & 0xFF;
+  record[7] = model->seed >> 8;
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+    packOutput(i, record + PRESET_OUTPUTS_OFFSET + i * PRESET_OUTPUT_SIZE);
+  record[PRESET_RECORD_SIZE - 1] = checksum(record);
+
+  /* Next position that holds no slot's latest record */
+  uint8_t r = newestRecord;
+  bool live;
+  do
+  {
+    r = r + 1 >= PRESET_JOURNAL_RECORDS ? 0 : r + 1;
+    live = false;
+    for (uint8_t i = 0; i < NUM_PRESETS; i++)
+    {
+      if (slotRecord[i] == r)
+        live = true;
+    }
+  } while (live);
+
+  writeRecord = r;
+  writeIndex = 0;
+  writeSlot = slot;
+  return true;
+}
+
+/*
+   Write the next byte of a save if the EEPROM is ready. Called on every
+   main loop pass.
+*/
+void CmPreset::update()
+{
+  if (!saving() || !halEepromReady())
+    return;
+
+  halEepromWrite(recordAddress(writeRecord) + writeIndex, writeBuffer[writeIndex]);
+  if (++writeIndex < PRESET_RECORD_SIZE)
+    return;
+
+  slotRecord[writeSlot] = writeRecord;
+  slotSerial[writeSlot] = nextSerial;
+  newestRecord = writeRecord;
+  nextSerial++;
+  writeSlot = NO_RECORD;
+
+  if (model->presetStatus == PRESET_SAVING)
+  {
+    model->presetStatus = PRESET_SAVED;
+    model->renderView = true;
+  }
+}
+
+/*
+   Stage slot in the tick to take over on the next bar. Returns false if
+   the slot is empty.
+*/
+bool CmPreset::recall(uint8_t slot)
+{
+  uint8_t record[PRESET_RECORD_SIZE];
+  uint32_t start = micros();
+
+  if (slotRecord[slot] == NO_RECORD || !readRecord(slotRecord[slot], record))
+    return false;
+
+  /* The tick takes the previous recall within one Timer1 period */
+  while (!model->presetReady())
+    ;
+
+  /* Random sequences are generated with the seed of the preset */
+  uint16_t seed = record[6] | record[7] << 8;
+  if (seed > MAX_RANDOM_SEED)
+    seed = 0;
+  model->seed = seed;
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+    unpackOutput(i, record + PRESET_OUTPUTS_OFFSET + i * PRESET_OUTPUT_SIZE);
+  model->commitPreset(record[3], record[4], record[5], seed);
+
+  recallMicros = micros() - start;
+  return true;
+}
@@ -0,0 +1,97 @@
+/*
+   Preset slots for Clock Module
+
+   NUM_PRESETS slots of tempo, swing, random seed and the settings of all
+   outputs, kept in EEPROM as a journal of PRESET_RECORD_SIZE records. A
+   save appends a record on the next free position after the newest one,
+   skipping positions that hold the latest record of any slot, so writes
+   go round the whole EEPROM instead of hitting the same cells. The
+   newest record of a slot is the one with the highest serial.
+
+   Record layout:
+
+     0  serial, low byte first
+     2  slot
+     3  BPM, bpmFraction, swing
+     6  random seed, low byte first
+     8  NUM_OUTPUTS * PRESET_OUTPUT_SIZE packed output settings
+     56 checksum, written last
+
+   A save is written one byte per main loop pass while the EEPROM is
+   ready, so the loop never waits for the 3.3 ms byte write. A recall
+   stages all outputs, tempo and swing in the tick and commits them on the
+   next bar while the clock keeps running.
+
+*/
+
+#ifndef CMPRESET_H
+#define CMPRESET_H
+
+#include <Arduino.h>
+#include "CmModel.h"
+
+#define PRESET_OUTPUT_SIZE 6
+#define PRESET_HEADER_SIZE 3
+#define PRESET_OUTPUTS_OFFSET (PRESET_HEADER_SIZE + 5)
+#define PRESET_RECORD_SIZE (PRESET_OUTPUTS_OFFSET + NUM_OUTPUTS * PRESET_OUTPUT_SIZE + 1)
+#define PRESET_JOURNAL_RECORDS (PRESET_EEPROM_SIZE / PRESET_RECORD_SIZE)
+#define NO_RECORD 255
+
+class CmPreset
+{
+private:
+  // Private constructor to achieve singleton pattern
+  CmPreset();
+  CmPreset(CmPreset const &);       // Copy disabled
+  void operator=(CmPreset const &); // Assigment disabled
+
+  CmModel *model;
+
+  /* Latest record of each slot, NO_RECORD if the slot is empty */
+  uint8_t slotRecord[NUM_PRESETS];
+  uint16_t slotSerial[NUM_PRESETS];
+  uint8_t newestRecord = NO_RECORD;
+  uint16_t nextSerial = 0;
+
+  /* Record being written by update(), writeSlot is NO_RECORD when idle */
+  uint8_t writeBuffer[PRESET_RECORD_SIZE];
+  uint8_t writeSlot = NO_RECORD;
+  uint8_t writeRecord;
+  uint8_t writeIndex;
+
+  static uint16_t recordAddress(uint8_t r)
+  {
+    return (uint16_t)r * PRESET_RECORD_SIZE;
+  }
+  static uint8_t checksum(const uint8_t *record);
+  bool readRecord(uint8_t r, uint8_t *record);
+  void packOutput(uint8_t n, uint8_t *p);
+  void unpackOutput(uint8_t n, const uint8_t *p);
+
+public:
+  // Static method to get the instance
+  static CmPreset *getInstance()
+  {
+    static CmPreset preset;
+    return &preset;
+  };
+
+  void setModel(CmModel *model)
+  {
+    this->model = model;
+  }
+
+  /* Time taken by the last recall in the main loop, EEPROM to queue */
+  uint32_t recallMicros = 0;
+
+  void initialize();
+  void update();
+  bool save(uint8_t slot);
+  bool recall(uint8_t slot);
+  bool saving()
+  {
+    return writeSlot != NO_RECORD;
+  }
+};
+
+#endif
@@ -17,38 +17,71 @@ CmView::CmView()
   oled.begin(&SH1106_128x64, I2C_ADDRESS);
 
   oled.setFont(DEFAULT_FONT);
+
+  textClear(0);
+  displayBytesEstimate = 0;
 }
 
 void CmView::render()
 {
-
-  /*
-     Display update
-  */
+  if (renderState == RENDER_IDLE)
+    displayBytesEstimate = 0;
 
   if (model->viewChanged)
   {
-    oled.clear();
+    /* Display is cleared one row per slice before the page is drawn */
+    model->viewChanged = false;
+    renderFull = true;
+    renderState = RENDER_CLEAR;
+    renderRow = 0;
+  }
+  else if (renderState != RENDER_CLEAR)
+  {
+    renderState = RENDER_PAGE;
   }
+  renderPageSlice = 0;
+}
 
-  if (DEBUG_VIEW)
-    Serial.println(F("---------------------"));
+bool CmView::renderSlice()
+{
+  switch (renderState)
+  {
+  case RENDER_IDLE:
+    return false;
 
-  oled.setFont(DEFAULT_FONT);
+  case RENDER_CLEAR:
+    oled.setFont(DEFAULT_FONT);
+    oled.setCursor(0, renderRow);
+    oled.clearToEOL();
+    displayBytesEstimate += 3 * 3 + 128;
+    if (++renderRow == TEXT_ROWS)
+    {
+      textClear(' ');
+      renderState = RENDER_PAGE;
+    }
+    return true;
 
-  switch (model->currentMode)
-  {
-  case MODE_BPM:
-    updateDisplay_BPM();
-    break;
-  case MODE_SWING:
-    updateDisplay_SWING();
-    break;
-  case MODE_OUTPUT_LIST:
-    updateDisplay_OUTPUT_LIST();
-    break;
-  case MODE_OUTPUT_SETTINGS:
-    updateDisplay_OUTPUT_SETTINGS();
+  case RENDER_PAGE:
+    if (DEBUG_VIEW && renderPageSlice == 0)
+      Serial.println(F("---------------------"));
+
+    oled.setFont(DEFAULT_FONT);
+    if (!updateDisplay(renderPageSlice++))
+    {
+      renderState = RENDER_FLUSH;
+      renderRow = 0;
+    }
+    return true;
+
+  case RENDER_FLUSH:
+    while (renderRow < TEXT_ROWS && !textDirty[renderRow])
+      renderRow++;
+
+    if (renderRow < TEXT_ROWS)
+    {
+      textFlushRow(renderRow++);
+      return true;
+    }
     break;
   }
 
@@ -59,53 +92,139 @@ void CmView::render()
     Serial.println(model->currentMode);
     Serial.print("type: ");
     Serial.println(model->editType);
+    Serial.print("I2C bytes, estimated: ");
+    Serial.println(displayBytesEstimate);
     Serial.println();
   }
 
-  if (model->viewChanged)
+  renderState = RENDER_IDLE;
+  renderFull = false;
+  return false;
+}
+
+/*
+   Draw one slice of the current page, returns true if more slices follow.
+   Text pages compose into the text shadow in one slice, big font pages
+   draw straight to the display one part per slice.
+*/
+bool CmView::updateDisplay(uint8_t slice)
+{
+  switch (model->currentMode)
   {
-    model->viewChanged = false;
+  case MODE_BPM:
+    return updateDisplay_BPM(slice);
+  case MODE_SWING:
+    return updateDisplay_SWING(slice);
+  case MODE_COMMIT:
+    return updateDisplay_COMMIT(slice);
+  case MODE_PRESET:
+    return updateDisplay_PRESET(slice);
+  case MODE_SEED:
+    return updateDisplay_SEED(slice);
+  case MODE_DIAGNOSTICS:
+    return updateDisplay_DIAGNOSTICS(slice);
+  case MODE_OUTPUT_LIST:
+    return updateDisplay_OUTPUT_LIST(slice);
+  case MODE_OUTPUT_SETTINGS:
+    return updateDisplay_OUTPUT_SETTINGS(slice);
   }
+  return false;
 }
 
-void CmView::updateDisplay_BPM()
+bool CmView::updateDisplay_BPM(uint8_t slice)
 {
-  if (DEBUG_VIEW)
+  /* Taken once per render, all slices show the same tempo */
+  if (slice == 0)
   {
-    Serial.println(F("BPM"));
-    Serial.println(model->BPM);
+    renderSync = model->syncActive;
+    if (renderSync)
+      renderCentiBpm = model->syncCentiBpm();
+    else
+      renderCentiBpm = model->BPM * BPM_FRACTION_STEPS + model->bpmFraction;
   }
+  byte bpm = renderCentiBpm / BPM_FRACTION_STEPS;
+  byte bpmFraction = renderCentiBpm % BPM_FRACTION_STEPS;
+  bool sync = renderSync;
+
+  switch (slice)
+  {
+  case 0:
+    if (DEBUG_VIEW)
+    {
+      Serial.println(F("BPM"));
+      Serial.println(bpm);
+    }
+
+    textInvalidateRows(0, TEXT_ROWS);
 
-  oled.setCursor(54, 6);
+    oled.setFont(Iain5x7);
+    if (sync)
+    {
+      oled.setCursor(46, 6);
+      oled.print(F("EXT BPM"));
+    }
+    else
+    {
+      oled.setCursor(54, 6);
+      oled.print(F("BPM"));
+    }
+    oled.clearToEOL();
+    return true;
 
+  case 1:
+    oled.setFont(BIG_NUMBER_FONT);
+    if (bpm < 100)
+    {
+      oled.setCursor(0, 2);
+      oled.clearToEOL();
+    }
+    return true;
+
+  case 2:
+    oled.setFont(BIG_NUMBER_FONT);
+    oled.setCursor(bpm > 99 ? 40 : 45, 2);
+    oled.print(bpm);
+    return true;
+
+  case 3:
+    oled.setFont(BIG_NUMBER_FONT);
+    oled.clearToEOL();
+    return true;
+  }
+
+  /* Hundredths in small font after the big digits, the cursor is
+     left there by the previous slices */
   oled.setFont(Iain5x7);
-  oled.println(F("BPM"));
-  oled.setFont(BIG_NUMBER_FONT);
-  if (model->BPM == 99)
+  oled.setCursor(oled.col(), 4);
+  if (bpmFraction > 0 || sync)
   {
-    oled.setCursor(0, 2);
-    oled.clearToEOL();
+    oled.print(F("."));
+    if (bpmFraction < 10)
+      oled.print(F("0"));
+    oled.print(bpmFraction);
   }
-  uint8_t pos = 45;
-  if (model->BPM > 99)
-    pos = pos - 5;
-  oled.setCursor(pos, 2);
-  oled.print(model->BPM);
   oled.clearToEOL();
-  oled.setFont(DEFAULT_FONT);
+  return false;
 }
 
-void CmView::updateDisplay_SWING()
+bool CmView::updateDisplay_SWING(uint8_t slice)
 {
-  if (DEBUG_VIEW)
+  if (slice == 0)
   {
-    Serial.println(F("Swing"));
-    Serial.println(model->swing);
+    if (DEBUG_VIEW)
+    {
+      Serial.println(F("Swing"));
+      Serial.println(model->swing);
+    }
+
+    textInvalidateRows(0, TEXT_ROWS);
+
+    oled.setCursor(50, 6);
+    oled.setFont(Iain5x7);
+    oled.println(F("Swing"));
+    return true;
   }
 
-  oled.setCursor(50, 6);
-  oled.setFont(Iain5x7);
-  oled.println(F("Swing"));
   oled.setFont(BIG_NUMBER_FONT);
   if (model->swing == 9)
   {
@@ -118,10 +237,202 @@ void CmView::updateDisplay_SWING()
   oled.setCursor(pos, 2);
   oled.print(model->swing);
   oled.clearToEOL();
-  oled.setFont(DEFAULT_FONT);
+  return false;
+}
+
+bool CmView::updateDisplay_COMMIT(uint8_t slice)
+{
+  const char *str = QUANTUM_TO_STR[model->quantum];
+
+  switch (slice)
+  {
+  case 0:
+    if (DEBUG_VIEW)
+    {
+      Serial.println(F("Commit"));
+      Serial.println(str);
+    }
+
+    textInvalidateRows(0, TEXT_ROWS);
+
+    oled.setCursor(40, 6);
+    oled.setFont(Iain5x7);
+    oled.println(F("Commit at"));
+    return true;
+
+  case 1:
+    oled.setFont(Arial_bold_14);
+    oled.setCursor(0, 2);
+    oled.clearToEOL();
+    return true;
+  }
+
+  oled.setFont(Arial_bold_14);
+  oled.setCursor((128 - oled.strWidth(str)) / 2, 2);
+  oled.print(str);
+  return false;
 }
 
-void CmView::updateDisplay_OUTPUT_LIST()
+bool CmView::updateDisplay_PRESET(uint8_t slice)
+{
+  uint8_t action = model->presetAction;
+
+  /* "Load 1".."Save n", NUM_PRESETS is a single digit */
+  char str[8];
+  strcpy(str, PRESET_ACTION_TO_STR[action / NUM_PRESETS]);
+  str[5] = '1' + action % NUM_PRESETS;
+  str[6] = 0;
+
+  switch (slice)
+  {
+  case 0:
+    if (DEBUG_VIEW)
+    {
+      Serial.println(F("Preset"));
+      Serial.println(str);
+    }
+
+    textInvalidateRows(0, TEXT_ROWS);
+
+    oled.setCursor(34, 6);
+    oled.setFont(Iain5x7);
+    oled.print(F("Preset "));
+    oled.print(PRESET_STATUS_TO_STR[model->presetStatus]);
+    oled.clearToEOL();
+    return true;
+
+  case 1:
+    oled.setFont(Arial_bold_14);
+    oled.setCursor(0, 2);
+    oled.clearToEOL();
+    return true;
+  }
+
+  oled.setFont(Arial_bold_14);
+  oled.setCursor((128 - oled.strWidth(str)) / 2, 2);
+  oled.print(str);
+  return false;
+}
+
+bool CmView::updateDisplay_SEED(uint8_t slice)
+{
+  /* "Free" or the seed, MAX_RANDOM_SEED has three digits */
+  char str[5];
+  uint16_t seed = model->editSeed;
+  if (seed == 0)
+  {
+    strcpy(str, "Free");
+  }
+  else
+  {
+    uint8_t i = seed >= 100 ? 3 : seed >= 10 ? 2 : 1;
+    str[i] = 0;
+    while (i--)
+    {
+      str[i] = '0' + seed % 10;
+      seed /= 10;
+    }
+  }
+
+  switch (slice)
+  {
+  case 0:
+    if (DEBUG_VIEW)
+    {
+      Serial.println(F("Seed"));
+      Serial.println(str);
+    }
+
+    textInvalidateRows(0, TEXT_ROWS);
+
+    oled.setCursor(31, 6);
+    oled.setFont(Iain5x7);
+    if (model->editSeed == model->seed)
+      oled.print(F("Random seed"));
+    else
+      oled.print(F("Hold to use"));
+    oled.clearToEOL();
+    return true;
+
+  case 1:
+    oled.setFont(Arial_bold_14);
+    oled.setCursor(0, 2);
+    oled.clearToEOL();
+    return true;
+  }
+
+  oled.setFont(Arial_bold_14);
+  oled.setCursor((128 - oled.strWidth(str)) / 2, 2);
+  oled.print(str);
+  return false;
+}
+
+bool CmView::updateDisplay_DIAGNOSTICS(uint8_t /* slice */)
+{
+#if PROFILE_TICK
+  /* REFERENCE
+    123456789012345678901
+
+    PWM     max     123us
+    <  8 12345 <128     0
+    < 16   123 <256     0
+    < 32    12 <512     0
+    < 64     0 >512     0
+
+    Overruns            0
+    Ticks        12345678
+  */
+
+  TickProfile p;
+  uint8_t kind = model->diagnosticsKind;
+  model->copyTickProfile(p);
+
+  if (DEBUG_VIEW)
+    Serial.println(F("Diagnostics"));
+
+  textCursor(0, 0);
+  renderStr(TICK_KIND_TO_STR[kind]);
+  while (textCol < 8)
+    textPut(' ');
+  renderStr("max");
+  renderNumber((p.worst[kind] + 1) / 2, 8);
+  renderStr("us");
+  renderNewline();
+
+  for (uint8_t b = 0; b < TICK_PROFILE_BUCKETS / 2; b++)
+  {
+    for (uint8_t half = 0; half < TICK_PROFILE_BUCKETS; half += TICK_PROFILE_BUCKETS / 2)
+    {
+      uint16_t limit = TickProfile::bucketLimit(b + half);
+      if (half)
+        renderStr(SPACE);
+      if (limit)
+      {
+        renderStr("<");
+        renderNumber(limit / 2, 3);
+      }
+      else
+      {
+        renderStr(">");
+        renderNumber(TickProfile::bucketLimit(b + half - 1) / 2, 3);
+      }
+      renderNumber(p.histogram[kind][b + half], 6);
+    }
+    renderNewline();
+  }
+  renderNewline();
+
+  renderStr("Overruns");
+  renderNumber(p.overruns, 13);
+  renderNewline();
+  renderStr("Ticks");
+  renderNumber(p.ticks, 16);
+  renderNewline();
+#endif
+  return false;
+}
+
+bool CmView::updateDisplay_OUTPUT_LIST(uint8_t /* slice */)
 {
   byte &currentRow = model->currentRow;
 
@@ -141,26 +452,23 @@ void CmView::updateDisplay_OUTPUT_LIST()
 
   */
 
-  oled.setFont(DEFAULT_FONT);
-
-  oled.setCursor(0, 0);
+  textCursor(0, 0);
 
   for (int i = 0; i < 8; i++)
   {
-    OutputType type = model->outputs[i]->type;
+    uint8_t type = model->outputs[i]->type;
 
     renderValue(i + 1);
     renderStr(SPACE);
 
     /* Indicate changes which are not yet active/committed */
 
-    if (currentRow == i)
-    {
-      if (model->outputChangesReadyForCommit)
-        renderStr(ROW_INDICATOR_COMMIT);
-      else
-        renderStr(ROW_INDICATOR);
-    }
+    if (model->outputCommitArmed(i))
+      renderStr(ROW_INDICATOR_ARMED);
+    else if (model->outputCommitPending(i))
+      renderStr(ROW_INDICATOR_COMMIT);
+    else if (currentRow == i)
+      renderStr(ROW_INDICATOR);
     else
       renderStr(SPACE);
 
@@ -214,38 +522,31 @@ void CmView::updateDisplay_OUTPUT_LIST()
       renderNewline();
     }
   }
+  return false;
 }
 
-void CmView::updateDisplay_OUTPUT_SETTINGS()
+bool CmView::updateDisplay_OUTPUT_SETTINGS(uint8_t slice)
 {
   byte &currentOutput = model->currentOutput;
-  byte &currentRow = model->currentRow;
-
-  Output *current_output = model->outputs[currentOutput];
-  OutputType type = current_output->type;
 
-  oled.setFont(Arial_bold_14);
-
-  if (model->viewChanged)
+  if (renderFull && slice == 0)
   {
+    oled.setFont(Arial_bold_14);
     oled.setCursor(0, 0);
     oled.print(F("CHANNEL "));
-    renderValue(currentOutput + 1);
+    oled.print(currentOutput + 1);
+    textInvalidateRows(0, 2);
+    return true;
   }
 
-  oled.setFont(DEFAULT_FONT);
-
-  // Render previous row indicator away
-  for (int i = 2; i < 6; i++)
-  {
-    oled.setCursor(59, i);
-    oled.print(SPACE);
-  }
+  /*
+     All rows are rendered every time, the text shadow takes care of
+     sending only what changed (value, row indicator, rows appearing or
+     disappearing on type change).
+  */
 
-  if (currentRow == 0 || model->viewChanged)
-    renderEditOutputFieldFromString(0, ROW_TYPE, TYPE_TO_LONG_STR[model->editType]);
-  if (currentRow == 1 || model->viewChanged)
-    renderEditOutputFieldFromString(1, ROW_CLOCK, CLOCK_TO_LONG_STR[model->editClockLength]);
+  renderEditOutputFieldFromString(0, ROW_TYPE, TYPE_TO_LONG_STR[model->editType]);
+  renderEditOutputFieldFromString(1, ROW_CLOCK, CLOCK_TO_LONG_STR[model->editClockLength]);
 
   switch (model->editType)
   {
@@ -254,39 +555,48 @@ void CmView::updateDisplay_OUTPUT_SETTINGS()
   case SAW:
   case SAW_INVERTED:
   case SINE:
-    if (currentRow == 2 || model->viewChanged || model->typeChanged)
-      renderEditOutputFieldFromString(2, ROW_GATE, CLOCK_TO_LONG_STR[model->editGateLength]);
-    if (currentRow == 3 || model->viewChanged || model->typeChanged)
-      renderEditOutputFieldFromString(3, ROW_DELAY, CLOCK_TO_LONG_STR[model->editStartDelayLength]);
+    renderEditOutputFieldFromString(2, ROW_GATE, CLOCK_TO_LONG_STR[model->editGateLength]);
+    renderEditOutputFieldFromString(3, ROW_DELAY, CLOCK_TO_LONG_STR[model->editStartDelayLength]);
+    // Phase and rate rows only exist for LFO types
+    if (model->editType != CLOCK)
+    {
+      renderEditOutputFieldFromString(4, ROW_PHASE, PHASE_TO_STR[model->editLfoPhaseOffset / LFO_PHASE_OFFSET_STEP]);
+      renderEditOutputFieldFromString(5, ROW_RATE, LFO_RATE_TO_STR[model->editLfoRate]);
+    }
+    else
+    {
+      renderEditOutputFieldFromString(4, SPACE, SPACE);
+      renderEditOutputFieldFromString(5, SPACE, SPACE);
+    }
     break;
 
   case EUCLIDEAN:
-    if (currentRow == 2 || model->viewChanged || model->typeChanged)
-      renderEditOutputFieldFromByte(2, ROW_LENGTH, model->editSequenceLength);
-    if (currentRow == 3 || model->viewChanged || model->typeChanged)
-      renderEditOutputFieldFromByte(3, ROW_STEPS, model->editEuclideanSteps);
+    renderEditOutputFieldFromByte(2, ROW_LENGTH, model->editSequenceLength);
+    renderEditOutputFieldFromByte(3, ROW_STEPS, model->editEuclideanSteps);
+    renderEditOutputFieldFromByte(4, ROW_ROTATE, model->editEuclideanRotation);
+    renderEditOutputFieldFromString(5, SPACE, SPACE);
     break;
 
   case RANDOM_TRIGGERS:
-    if (currentRow == 2 || model->viewChanged || model->typeChanged)
-      renderEditOutputFieldFromByte(2, ROW_PROB, model->editRandomTriggerProbability);
-    if (currentRow == 3 || model->viewChanged || model->typeChanged)
-      renderEditOutputFieldFromByte(3, ROW_SEQUENCE, model->editSequenceLength);
+    renderEditOutputFieldFromByte(2, ROW_PROB, model->editRandomTriggerProbability);
+    renderEditOutputFieldFromByte(3, ROW_SEQUENCE, model->editSequenceLength);
+    renderEditOutputFieldFromString(4, SPACE, SPACE);
+    renderEditOutputFieldFromString(5, SPACE, SPACE);
     break;
 
   case VOLTAGE:
-    if (currentRow == 2 || model->viewChanged || model->typeChanged)
-    {
-      renderEditOutputFieldFromByte(2, ROW_SEQUENCE, model->editSequenceLength);
-      renderEditOutputFieldFromString(3, SPACE, SPACE);
-    }
+    renderEditOutputFieldFromByte(2, ROW_SEQUENCE, model->editSequenceLength);
+    renderEditOutputFieldFromString(3, SPACE, SPACE);
+    renderEditOutputFieldFromString(4, SPACE, SPACE);
+    renderEditOutputFieldFromString(5, SPACE, SPACE);
     break;
   }
+  return false;
 }
 
-void CmView::renderEditOutputFieldFromString(uint8_t n_row, char *f_name, char *f_value)
+void CmView::renderEditOutputFieldFromString(uint8_t n_row, const char *f_name, const char *f_value)
 {
-  oled.setCursor(0, n_row + 2);
+  textCursor(0, n_row + 2);
   renderStr(f_name);
   if (model->currentRow == n_row)
     renderStr(ROW_INDICATOR);
@@ -296,9 +606,9 @@ void CmView::renderEditOutputFieldFromString(uint8_t n_row, char *f_name, char *
   renderNewline();
 }
 
-void CmView::renderEditOutputFieldFromByte(uint8_t n_row, char *f_name, byte f_value)
+void CmView::renderEditOutputFieldFromByte(uint8_t n_row, const char *f_name, byte f_value)
 {
-  oled.setCursor(0, n_row + 2);
+  textCursor(0, n_row + 2);
   renderStr(f_name);
   if (model->currentRow == n_row)
     renderStr(ROW_INDICATOR);
@@ -308,31 +618,135 @@ void CmView::renderEditOutputFieldFromByte(uint8_t n_row, char *f_name, byte f_v
   renderNewline();
 }
 
-void CmView::renderStr(char *str)
+void CmView::renderStr(const char *str)
 {
   if (DEBUG_VIEW)
     Serial.print(str);
-  oled.print(str);
+  while (*str)
+    textPut(*str++);
 }
 
 void CmView::renderValue(byte b)
 {
   if (DEBUG_VIEW)
     Serial.print(b);
-  oled.print(b);
+  if (b >= 100)
+    textPut('0' + b / 100);
+  if (b >= 10)
+    textPut('0' + b / 10 % 10);
+  textPut('0' + b % 10);
+}
+
+/*
+   Number right aligned in width cells
+*/
+void CmView::renderNumber(uint32_t v, uint8_t width)
+{
+  char str[11];
+  uint8_t i = sizeof(str) - 1;
+
+  str[i] = 0;
+  do
+  {
+    str[--i] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  for (uint8_t digits = sizeof(str) - 1 - i; digits < width; width--)
+    textPut(' ');
+  renderStr(str + i);
 }
 
 void CmView::renderNewline()
 {
   if (DEBUG_VIEW)
     Serial.println();
-  oled.clearToEOL();
-  oled.println();
+  while (textCol < TEXT_COLS)
+    textPut(' ');
+  textCol = 0;
+  textRow++;
+}
+
+void CmView::textCursor(uint8_t col, uint8_t row)
+{
+  textCol = col;
+  textRow = row;
+}
+
+void CmView::textPut(char c)
+{
+  if (textRow < TEXT_ROWS && textCol < TEXT_COLS)
+  {
+    if (textShadow[textRow][textCol] != c)
+    {
+      textShadow[textRow][textCol] = c;
+      textDirty[textRow] |= 1UL << textCol;
+    }
+  }
+  textCol++;
+}
+
+/*
+   Send runs of changed cells in one row to the display, one cursor move
+   per run.
+*/
+void CmView::textFlushRow(uint8_t row)
+{
+  char run[TEXT_COLS + 1];
+  uint32_t dirty = textDirty[row];
+  uint8_t col = 0;
+
+  oled.setFont(DEFAULT_FONT);
+
+  while (dirty)
+  {
+    while (!(dirty & 1))
+    {
+      dirty >>= 1;
+      col++;
+    }
+
+    uint8_t len = 0;
+    while (dirty & 1)
+    {
+      run[len] = textShadow[row][col + len];
+      len++;
+      dirty >>= 1;
+    }
+    run[len] = 0;
+
+    oled.setCursor(col * TEXT_CELL_WIDTH, row);
+    oled.print(run);
+    displayBytesEstimate += 3 + len * TEXT_CELL_WIDTH;
+    col += len;
+  }
+
+  textDirty[row] = 0;
+}
+
+/*
+   Set the whole shadow to c: ' ' after the display has been cleared,
+   0 when its contents are unknown.
+*/
+void CmView::textClear(char c)
+{
+  memset(textShadow, c, sizeof(textShadow));
+  memset(textDirty, 0, sizeof(textDirty));
+}
+
+/*
+   Forget the contents of rows drawn over with another font, so the next
+   text written there is sent in full.
+*/
+void CmView::textInvalidateRows(uint8_t first, uint8_t count)
+{
+  memset(textShadow[first], 0, count * TEXT_COLS);
 }
 
 void CmView::displaySplashScreen()
 {
   oled.clear();
+  textClear(0);
+  renderState = RENDER_IDLE;
   oled.setFont(Arial_bold_14);
   oled.setCursor(26, 2);
   oled.print(F("ClockWork"));
@@ -344,8 +758,10 @@ void CmView::displaySplashScreen()
 void CmView::displayScreensaver()
 {
   oled.clear();
+  textClear(0);
+  renderState = RENDER_IDLE;
   oled.setFont(Arial_bold_14);
-  oled.setCursor(random(60), random(7));
+  oled.setCursor(model->uiRandom.next() % 60, model->uiRandom.next() % 7);
   oled.print(F("ClockWork"));
   oled.setFont(DEFAULT_FONT);
 }
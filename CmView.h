@@ -13,6 +13,19 @@
 // Define proper RST_PIN if required.
 #define RST_PIN -1
 
+// Character cells of DEFAULT_FONT on the 128x64 display
+#define TEXT_COLS 21
+#define TEXT_ROWS 8
+#define TEXT_CELL_WIDTH 6
+
+enum RenderState
+{
+  RENDER_IDLE = 0,
+  RENDER_CLEAR = 1,
+  RENDER_PAGE = 2,
+  RENDER_FLUSH = 3
+};
+
 class CmView
 {
 private:
@@ -23,16 +36,52 @@ private:
 
   CmModel *model;
   SSD1306AsciiWire oled;
-  void updateDisplay_BPM();
-  void updateDisplay_SWING();
-  void updateDisplay_OUTPUT_LIST();
-  void updateDisplay_OUTPUT_SETTINGS();
-  void renderEditOutputFieldFromString(uint8_t n_row, char *f_name, char *f_value);
-  void renderEditOutputFieldFromByte(uint8_t n_row, char *f_name, byte f_value);
-  void renderStr(char *s);
+  /*
+     Render progress between renderSlice() calls. renderRow is the display
+     row being cleared or flushed, renderPageSlice the next slice of the
+     page drawing. renderFull is set while a render that started with a
+     cleared display is in progress.
+  */
+  RenderState renderState = RENDER_IDLE;
+  uint8_t renderRow;
+  uint8_t renderPageSlice;
+  bool renderFull;
+  uint16_t renderCentiBpm; /* Tempo and source shown by the BPM page */
+  bool renderSync;         /* being rendered                         */
+
+  bool updateDisplay(uint8_t slice);
+  bool updateDisplay_BPM(uint8_t slice);
+  bool updateDisplay_SWING(uint8_t slice);
+  bool updateDisplay_COMMIT(uint8_t slice);
+  bool updateDisplay_PRESET(uint8_t slice);
+  bool updateDisplay_SEED(uint8_t slice);
+  bool updateDisplay_DIAGNOSTICS(uint8_t slice);
+  bool updateDisplay_OUTPUT_LIST(uint8_t slice);
+  bool updateDisplay_OUTPUT_SETTINGS(uint8_t slice);
+  void renderEditOutputFieldFromString(uint8_t n_row, const char *f_name, const char *f_value);
+  void renderEditOutputFieldFromByte(uint8_t n_row, const char *f_name, byte f_value);
+  void renderStr(const char *s);
   void renderValue(byte b);
+  void renderNumber(uint32_t v, uint8_t width);
   void renderNewline();
 
+  /*
+     Shadow of the DEFAULT_FONT text on the display, one char per cell.
+     Text is written into the shadow during render() and only cells that
+     changed are sent to the display at the end of it, as one cursor move
+     per run of changed cells. A 0 cell means the display contents there
+     are unknown (cleared area or drawn with another font).
+  */
+  char textShadow[TEXT_ROWS][TEXT_COLS];
+  uint32_t textDirty[TEXT_ROWS];
+  uint8_t textCol;
+  uint8_t textRow;
+  void textCursor(uint8_t col, uint8_t row);
+  void textPut(char c);
+  void textFlushRow(uint8_t row);
+  void textClear(char c);
+  void textInvalidateRows(uint8_t first, uint8_t count);
+
 public:
   // Static method to get the instance
   static CmView *getInstance()
@@ -52,10 +101,31 @@ public:
   }
 
   /*
-     Render display based on model data.
+     Start rendering the display based on model data. Nothing is sent to
+     the display here: the work is done by renderSlice(), and a render
+     requested while another is in progress restarts it from the current
+     model state.
   */
   void render();
 
+  /*
+     Do one bounded slice of render work: clear or flush one display row,
+     or draw one part of a big font page. Returns true while the render
+     is not complete.
+  */
+  bool renderSlice();
+
+  /*
+     Estimate of the bytes sent to the display by the text layer and
+     screen clears since the render in progress (or the last one)
+     started. The display library does not report what it sends, so
+     each row clear counts its three cursor commands and 128 data bytes,
+     and each run of changed cells counts three cursor commands and
+     TEXT_CELL_WIDTH data bytes per cell. I2C framing and big font pages
+     are not included. The host simulator counts the actual bytes.
+  */
+  uint16_t displayBytesEstimate;
+
   void displaySplashScreen();
   void displayScreensaver();
 };
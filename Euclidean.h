@@ -0,0 +1,161 @@
+/*
+   Euclidean rhythm patterns for Clock Module
+
+   Every pattern of k = 1..n onsets in n = 1..EUCLIDEAN_TABLE_LENGTH
+   steps, step j in bit j. This is the output of
+   Output::generateEuclideanRhythm() for each (k, n), kept in flash so
+   changing steps or length on the settings page is a table lookup for
+   the common lengths. Longer patterns are generated.
+
+   Patterns of length n start at index n * (n - 1) / 2, k - 1 further on.
+
+*/
+
+#ifndef EUCLIDEAN_H
+#define EUCLIDEAN_H
+
+#include <Arduino.h>
+#include "Resources.h"
+
+#define EUCLIDEAN_TABLE_LENGTH 32
+#define EUCLIDEAN_PATTERN_INDEX(k, n) ((uint16_t)(n) * ((n)-1) / 2 + (k)-1)
+#define NUM_EUCLIDEAN_PATTERNS EUCLIDEAN_PATTERN_INDEX(1, EUCLIDEAN_TABLE_LENGTH + 1)
+
+static const uint32_t PROGMEM EUCLIDEAN_PATTERNS[NUM_EUCLIDEAN_PATTERNS] = {
+    /* n = 1 */
+    0x00000001,
+    /* n = 2 */
+    0x00000001, 0x00000003,
+    /* n = 3 */
+    0x00000001, 0x00000005, 0x00000007,
+    /* n = 4 */
+    0x00000001, 0x00000005, 0x0000000D, 0x0000000F,
+    /* n = 5 */
+    0x00000001, 0x00000009, 0x00000015, 0x0000001D, 0x0000001F,
+    /* n = 6 */
+    0x00000001, 0x00000009, 0x00000015, 0x0000002D, 0x0000003D, 0x0000003F,
+    /* n = 7 */
+    0x00000001, 0x00000011, 0x00000029, 0x00000055, 0x0000006D, 0x0000007D,
+    0x0000007F,
+    /* n = 8 */
+    0x00000001, 0x00000011, 0x00000049, 0x00000055, 0x000000B5, 0x000000DD,
+    0x000000FD, 0x000000FF,
+    /* n = 9 */
+    0x00000001, 0x00000021, 0x00000049, 0x000000A9, 0x00000155, 0x0000016D,
+    0x000001DD, 0x000001FD, 0x000001FF,
+    /* n = 10 */
+    0x00000001, 0x00000021, 0x00000091, 0x00000129, 0x00000155, 0x000002B5,
+    0x0000036D, 0x000003BD, 0x000003FD, 0x000003FF,
+    /* n = 11 */
+    0x00000001, 0x00000041, 0x00000111, 0x00000249, 0x000002A9, 0x00000555,
+    0x000005B5, 0x000006ED, 0x000007BD, 0x000007FD, 0x000007FF,
+    /* n = 12 */
+    0x00000001, 0x00000041, 0x00000111, 0x00000249, 0x00000529, 0x00000555,
+    0x00000AD5, 0x00000B6D, 0x00000DDD, 0x00000F7D, 0x00000FFD, 0x00000FFF,
+    /* n = 13 */
+    0x00000001, 0x00000081, 0x00000221, 0x00000491, 0x00000949, 0x00000AA9,
+    0x00001555, 0x000016B5, 0x00001B6D, 0x00001DDD, 0x00001F7D, 0x00001FFD,
+    0x00001FFF,
+    /* n = 14 */
+    0x00000001, 0x00000081, 0x00000421, 0x00000891, 0x00001249, 0x000014A9,
+    0x00001555, 0x00002AD5, 0x00002DB5, 0x000036ED, 0x00003BDD, 0x00003EFD,
+    0x00003FFD, 0x00003FFF,
+    /* n = 15 */
+    0x00000001, 0x00000101, 0x00000421, 0x00001111, 0x00001249, 0x00002529,
+    0x00002AA9, 0x00005555, 0x000056B5, 0x00005B6D, 0x00006EED, 0x000077BD,
+    0x00007EFD, 0x00007FFD, 0x00007FFF,
+    /* n = 16 */
+    0x00000001, 0x00000101, 0x00000841, 0x00001111, 0x00002491, 0x00004949,
+    0x000054A9, 0x00005555, 0x0000AB55, 0x0000B5B5, 0x0000DB6D, 0x0000DDDD,
+    0x0000F7BD, 0x0000FDFD, 0x0000FFFD, 0x0000FFFF,
+    /* n = 17 */
+    0x00000001, 0x00000201, 0x00001041, 0x00002221, 0x00004891, 0x00009249,
+    0x0000A529, 0x0000AAA9, 0x00015555, 0x00015AD5, 0x00016DB5, 0x0001B76D,
+    0x0001DDDD, 0x0001EFBD, 0x0001FDFD, 0x0001FFFD, 0x0001FFFF,
+    /* n = 18 */
+    0x00000001, 0x00000201, 0x00001041, 0x00004221, 0x00008911, 0x00009249,
+    0x00012949, 0x000152A9, 0x00015555, 0x0002AB55, 0x0002D6B5, 0x0002DB6D,
+    0x000376ED, 0x0003BBDD, 0x0003DF7D, 0x0003FBFD, 0x0003FFFD, 0x0003FFFF,
+    /* n = 19 */
+    0x00000001, 0x00000401, 0x00002081, 0x00008421, 0x00011111, 0x00012491,
+    0x00024A49, 0x00029529, 0x0002AAA9, 0x00055555, 0x00056AD5, 0x0005B5B5,
+    0x0006DB6D, 0x0006EEED, 0x00077BDD, 0x0007DF7D, 0x0007FBFD, 0x0007FFFD,
+    0x0007FFFF,
+    /* n = 20 */
+    0x00000001, 0x00000401, 0x00004081, 0x00008421, 0x00011111, 0x00024491,
+    0x00049249, 0x0004A529, 0x000552A9, 0x00055555, 0x000AAD55, 0x000AD6B5,
+    0x000B6DB5, 0x000DB76D, 0x000DDDDD, 0x000EF7BD, 0x000FBF7D, 0x000FF7FD,
+    0x000FFFFD, 0x000FFFFF,
+    /* n = 21 */
+    0x00000001, 0x00000801, 0x00004081, 0x00010841, 0x00022221, 0x00044891,
+    0x00049249, 0x00094949, 0x000A54A9, 0x000AAAA9, 0x00155555, 0x00156AD5,
+    0x0016B6B5, 0x0016DB6D, 0x001B76ED, 0x001DDDDD, 0x001EF7BD, 0x001F7EFD,
+    0x001FF7FD, 0x001FFFFD, 0x001FFFFF,
+    /* n = 22 */
+    0x00000001, 0x00000801, 0x00008101, 0x00020841, 0x00044221, 0x00088911,
+    0x00092491, 0x00124A49, 0x0014A529, 0x00154AA9, 0x00155555, 0x002AAD55,
+    0x002B5AD5, 0x002DADB5, 0x0036DB6D, 0x00376EED, 0x003BBDDD, 0x003DEFBD,
+    0x003F7EFD, 0x003FEFFD, 0x003FFFFD, 0x003FFFFF,
+    /* n = 23 */
+    0x00000001, 0x00001001, 0x00010101, 0x00041041, 0x00084421, 0x00111111,
+    0x00124491, 0x00249249, 0x00252949, 0x002A54A9, 0x002AAAA9, 0x00555555,
+    0x0055AB55, 0x005AD6B5, 0x005B6DB5, 0x006DBB6D, 0x006EEEED, 0x0077BBDD,
+    0x007BEFBD, 0x007EFEFD, 0x007FEFFD, 0x007FFFFD, 0x007FFFFF,
+    /* n = 24 */
+    0x00000001, 0x00001001, 0x00010101, 0x00041041, 0x00108421, 0x00111111,
+    0x00244891, 0x00249249, 0x00494949, 0x00529529, 0x00554AA9, 0x00555555,
+    0x00AAB555, 0x00AD5AD5, 0x00B5B5B5, 0x00B6DB6D, 0x00DBB76D, 0x00DDDDDD,
+    0x00EF7BDD, 0x00F7DF7D, 0x00FDFDFD, 0x00FFDFFD, 0x00FFFFFD, 0x00FFFFFF,
+    /* n = 25 */
+    0x00000001, 0x00002001, 0x00020201, 0x00082081, 0x00108421, 0x00222221,
+    0x00448911, 0x00492491, 0x00925249, 0x0094A529, 0x00A954A9, 0x00AAAAA9,
+    0x01555555, 0x0156AB55, 0x015AD6B5, 0x016DADB5, 0x01B6DB6D, 0x01BB76ED,
+    0x01DDDDDD, 0x01DEF7BD, 0x01F7DF7D, 0x01FDFDFD, 0x01FFDFFD, 0x01FFFFFD,
+    0x01FFFFFF,
+    /* n = 26 */
+    0x00000001, 0x00002001, 0x00040201, 0x00102081, 0x00210841, 0x00442221,
+    0x00889111, 0x00922491, 0x01249249, 0x01292949, 0x014A9529, 0x01552AA9,
+    0x01555555, 0x02AAB555, 0x02B56AD5, 0x02D6B6B5, 0x02DB6DB5, 0x036DBB6D,
+    0x03776EED, 0x03BBBDDD, 0x03DEF7BD, 0x03EFBF7D, 0x03FBFDFD, 0x03FFBFFD,
+    0x03FFFFFD, 0x03FFFFFF,
+    /* n = 27 */
+    0x00000001, 0x00004001, 0x00040201, 0x00204081, 0x00420841, 0x00844221,
+    0x01111111, 0x01224891, 0x01249249, 0x024A4A49, 0x0294A529, 0x02A552A9,
+    0x02AAAAA9, 0x05555555, 0x0556AB55, 0x056B5AD5, 0x05B5B5B5, 0x05B6DB6D,
+    0x06DDB76D, 0x06EEEEED, 0x0777BBDD, 0x07BDF7BD, 0x07DFBF7D, 0x07F7FBFD,
+    0x07FFBFFD, 0x07FFFFFD, 0x07FFFFFF,
+    /* n = 28 */
+    0x00000001, 0x00004001, 0x00080401, 0x00204081, 0x00821041, 0x01084421,
+    0x01111111, 0x02244891, 0x02492491, 0x04925249, 0x04A52949, 0x052A54A9,
+    0x05552AA9, 0x05555555, 0x0AAAD555, 0x0AB56AD5, 0x0B5AD6B5, 0x0B6D6DB5,
+    0x0DB6DB6D, 0x0DBB76ED, 0x0DDDDDDD, 0x0EF77BDD, 0x0F7DEFBD, 0x0FBF7EFD,
+    0x0FF7FBFD, 0x0FFF7FFD, 0x0FFFFFFD, 0x0FFFFFFF,
+    /* n = 29 */
+    0x00000001, 0x00008001, 0x00100401, 0x00408101, 0x01041041, 0x02108421,
+    0x02222221, 0x04488911, 0x04922491, 0x09249249, 0x09494949, 0x0A52A529,
+    0x0AA552A9, 0x0AAAAAA9, 0x15555555, 0x155AAD55, 0x15AD5AD5, 0x16B6B6B5,
+    0x16DB6DB5, 0x1B6DDB6D, 0x1BB776ED, 0x1DDDDDDD, 0x1DEF7BDD, 0x1EFBEFBD,
+    0x1FBF7EFD, 0x1FEFFBFD, 0x1FFF7FFD, 0x1FFFFFFD, 0x1FFFFFFF,
+    /* n = 30 */
+    0x00000001, 0x00008001, 0x00100401, 0x00808101, 0x01041041, 0x02108421,
+    0x04442221, 0x08889111, 0x09124491, 0x09249249, 0x12524A49, 0x1294A529,
+    0x152A54A9, 0x1554AAA9, 0x15555555, 0x2AAAD555, 0x2AD5AB55, 0x2B5AD6B5,
+    0x2DADB5B5, 0x2DB6DB6D, 0x36DDB76D, 0x3776EEED, 0x3BBBDDDD, 0x3BDEF7BD,
+    0x3DF7DF7D, 0x3F7EFEFD, 0x3FDFF7FD, 0x3FFEFFFD, 0x3FFFFFFD, 0x3FFFFFFF,
+    /* n = 31 */
+    0x00000001, 0x00010001, 0x00200801, 0x01010101, 0x02082081, 0x04210841,
+    0x08844221, 0x11111111, 0x12244891, 0x12492491, 0x24929249, 0x25292949,
+    0x29529529, 0x2A9552A9, 0x2AAAAAA9, 0x55555555, 0x556AAD55, 0x56AD6AD5,
+    0x5AD6D6B5, 0x5B6D6DB5, 0x6DB6DB6D, 0x6DDBB76D, 0x6EEEEEED, 0x777BBDDD,
+    0x7BDEF7BD, 0x7DF7DF7D, 0x7EFEFEFD, 0x7FDFF7FD, 0x7FFEFFFD, 0x7FFFFFFD,
+    0x7FFFFFFF,
+    /* n = 32 */
+    0x00000001, 0x00010001, 0x00400801, 0x01010101, 0x04102081, 0x08410841,
+    0x10884421, 0x11111111, 0x22448911, 0x24912491, 0x49249249, 0x49494949,
+    0x5294A529, 0x54A954A9, 0x5554AAA9, 0x55555555, 0xAAAB5555, 0xAB55AB55,
+    0xAD6B5AD5, 0xB5B5B5B5, 0xB6DB6DB5, 0xDB6DDB6D, 0xDDBB76ED, 0xDDDDDDDD,
+    0xEF77BBDD, 0xF7BDF7BD, 0xFBEFDF7D, 0xFDFDFDFD, 0xFFBFF7FD, 0xFFFDFFFD,
+    0xFFFFFFFD, 0xFFFFFFFF
+};
+
+#endif
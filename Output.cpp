@@ -6,14 +6,36 @@
 */
 
 #include "Output.h"
+#include "Euclidean.h"
 
-#define MAX_LONG 2147483647
+/*
+   First quarter of the SINE output waveform, 255 * (1 - cos(x)) / 2 for
+   x = 0..PI/2 in 64 steps. The other three quarters are mirrored from it
+   in sineLookup().
+*/
+static const uint8_t PROGMEM SINE_QUARTER_TABLE[65] = {
+    0, 0, 0, 0, 1, 1, 1, 2, 2, 3, 4, 5, 5, 6, 7, 9,
+    10, 11, 12, 14, 15, 17, 18, 20, 21, 23, 25, 27, 29, 31, 33, 35,
+    37, 40, 42, 44, 47, 49, 52, 54, 57, 59, 62, 65, 67, 70, 73, 76,
+    79, 82, 85, 88, 90, 93, 97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+    127};
+
+const OutputBehavior Output::BEHAVIORS[NUM_TYPES] PROGMEM = {
+    /* NO_OUTPUT       */ {handleNothing, handleNothing, false, false},
+    /* CLOCK           */ {handleNothing, handleNothing, false, false},
+    /* EUCLIDEAN       */ {resetEuclidean, stepEuclidean, false, true},
+    /* RANDOM_TRIGGERS */ {handleNothing, stepRandomTriggers, false, true},
+    /* SAW             */ {handleNothing, stepSaw, true, false},
+    /* SAW_INVERTED    */ {handleNothing, stepSawInverted, true, false},
+    /* SINE            */ {handleNothing, stepSine, true, false},
+    /* VOLTAGE         */ {resetVoltage, stepVoltage, true, false}};
 
 Output::Output(uint8_t p, uint8_t a)
 {
   PIN = p;
   ANALOG_PIN = a;
   type = NO_OUTPUT;
+  behavior = &BEHAVIORS[NO_OUTPUT];
   clockLength = NO_CLOCK;
   gateLength = NO_CLOCK;
   startDelayLength = NO_CLOCK;
@@ -24,20 +46,26 @@ Output::Output(uint8_t p, uint8_t a)
   t_gateOpen = 0;
   t_gateClose = 0;
   pwmPpqnCounter = 0;
-  event = NO_EVENT;
-  eventTime = 0;
+  lfoPhase = 0;
+  lfoPhaseStep = 0;
+  lfoPhaseOffset = 0;
+  lfoRate = LFO_RATE_X1;
+  lfoCycleDone = false;
 
   // Common sequences
-  sequence = 0;
-  sequenceB = 0;
+  steps.clear();
   sequenceIndex = 0;
   sequenceLength = 0;
 
   // Euclidean rhythms
   euclideanSteps = 0;
+  euclideanRotation = 0;
 
   // Random triggers
   randomTriggerProbability = 100;
+  randomTriggerThreshold = percentThreshold(100);
+  rng.seed(0);
+  rngSeed = 0;
 }
 
 Output::~Output() {}
@@ -47,33 +75,41 @@ Output::~Output() {}
 */
 void Output::reset()
 {
-  event = NO_EVENT;
-  eventTime = 0;
+  if (rngSeed)
+    rng.seed(rngSeed);
   gateOpen = true;
-  if (type == EUCLIDEAN)
-    sequenceIndex = sequenceLength - 2;
-  if (type != VOLTAGE)
-    pwm_out = 0;
+  pwm_out = 0;
   swinging = false;
-  if (startDelayLength > 0)
-    d_out = false;
-  else
-    d_out = true;
 
-  if (type == SAW || type == SAW_INVERTED || type == SINE || type == VOLTAGE)
+  bool cv = isCv();
+  if (cv)
   {
     pwmPpqnCounter = 0;
-    d_out = false;
+    resetLfoPhase();
     sequenceIndex = 0;
-    if (type == VOLTAGE)
-    {
-      if (sequenceLength > 0)
-        pwm_out = sequence >> sequenceIndex & 0xFF;
-      else
-        pwm_out = random(255) + 1;
-    }
   }
-  analogWrite(ANALOG_PIN, pwm_out);
+  ((OutputHandler)pgm_read_ptr(&behavior->reset))(this);
+
+  d_out = !cv && startDelayLength == 0 && gateOpen;
+}
+
+void Output::handleNothing(Output * /* o */)
+{
+}
+
+void Output::resetEuclidean(Output *o)
+{
+  /* First step is played now, gate events carry on from the second */
+  o->sequenceIndex = o->sequenceLength > 0 ? o->euclideanRotation % o->sequenceLength : 0;
+  o->handleEuclideanGate();
+}
+
+void Output::resetVoltage(Output *o)
+{
+  if (o->sequenceLength > 0)
+    o->pwm_out = o->steps.window(o->sequenceIndex);
+  else
+    o->pwm_out = o->randomVoltage();
 }
 
 /*
@@ -82,6 +118,7 @@ void Output::reset()
 void Output::setOutputType(uint8_t t)
 {
   type = t;
+  behavior = &BEHAVIORS[t];
 
   /*
      typedef enum OutputType {
@@ -95,15 +132,9 @@ void Output::setOutputType(uint8_t t)
     VOLTAGE         = 7
   */
 
-  if (type == SAW || type == SAW_INVERTED || type == SINE || type == VOLTAGE)
-  {
+  if (isCv())
     d_out = 0;
-    pwm_out = 0;
-  }
-  else
-  {
-    pwm_out = 0;
-  }
+  pwm_out = 0;
 }
 
 /**
@@ -120,16 +151,19 @@ void Output::setClockLength(uint8_t c)
 void Output::setGateLength(uint8_t c)
 {
 
-  if (type == EUCLIDEAN || type == RANDOM_TRIGGERS)
+  if (pgm_read_byte(&behavior->triggers))
   {
     c = CLOCK_1x256;
   }
 
   gateLength = c;
+  setLfoPeriod((uint32_t)pgm_read_word(&CLOCK_LENGTH_TO_PPQN[gateLength]) * pgm_read_byte(&LFO_RATE_DIVISOR[lfoRate]),
+               pgm_read_byte(&LFO_RATE_MULTIPLIER[lfoRate]));
 
-  if (type == SAW || type == SAW_INVERTED || type == SINE || type == VOLTAGE)
+  if (isCv())
   {
     pwmPpqnCounter = 0;
+    resetLfoPhase();
   }
 }
 
@@ -152,139 +186,166 @@ void Output::setStartDelayLength(uint8_t c)
 */
 
 /*
-   Setting event for GATE_OPEN and GATE_CLOSE
+   Event times for GATE_OPEN, GATE_CLOSE and the first event after a
+   start delay. The tick keeps the event and its time, see
+   CmModel::eventTime; these only read the output settings.
 */
-void Output::setEvent(Event e, EventTime t)
+EventTime Output::delayedEventTime(EventTime t)
 {
-  event = e;
-  eventTime = t;
+  return t + pgm_read_word(&CLOCK_LENGTH_TO_PPQN[startDelayLength]);
 }
 
-void Output::setDelayedEvent(Event e, EventTime t)
+EventTime Output::nextGateCloseTime(EventTime t)
 {
-  EventTime et = handleEventTimeOverflow(t + CLOCK_LENGTH_TO_PPQN[startDelayLength]);
-  setEvent(e, handleEventTimeOverflow(t + CLOCK_LENGTH_TO_PPQN[startDelayLength]));
+  return t + t_gateClose;
 }
 
-void Output::setGateCloseEvent(EventTime t)
+EventTime Output::nextGateOpenTime(EventTime t)
 {
-  setEvent(GATE_CLOSE, handleEventTimeOverflow(t + t_gateClose));
+  step();
+  return t + t_gateOpen;
 }
 
-void Output::setGateOpenEvent(EventTime t)
+EventTime Output::nextSwingGateOpenTime(EventTime t, uint8_t swing)
 {
-
-  if (type == EUCLIDEAN)
-  {
-    handleEuclideanGate();
-  }
-  else if (type == RANDOM_TRIGGERS)
+  step();
+  swinging = swinging ? false : true;
+  if (swinging)
   {
-    handleRandomTriggersGate();
+    return t + t_gateOpen + swing;
   }
-
-  setEvent(GATE_OPEN, handleEventTimeOverflow(t + t_gateOpen));
+  return t + t_gateOpen - swing;
 }
 
-void Output::setSwingGateOpenEvent(EventTime t, uint8_t swing)
+/*
+   Analog events
+*/
+void Output::handlePwmEvent()
 {
 
-  if (type == EUCLIDEAN)
-  {
-    handleEuclideanGate();
-  }
-  else if (type == RANDOM_TRIGGERS)
+  pwmPpqnCounter++;
+  step();
+
+  if (pwmPpqnCounter * PWM_EVENT_PPQN >= pgm_read_word(&CLOCK_LENGTH_TO_PPQN[clockLength]) - 1)
   {
-    handleRandomTriggersGate();
+    pwmPpqnCounter = 0;
+    resetLfoPhase();
   }
+}
 
-  if (swinging)
+void Output::stepVoltage(Output *o)
+{
+  if (o->pwmPpqnCounter * PWM_EVENT_PPQN < pgm_read_word(&CLOCK_LENGTH_TO_PPQN[o->clockLength]))
+    return;
+
+  if (o->sequenceLength == 0)
   {
-    setEvent(GATE_OPEN, handleEventTimeOverflow(t + t_gateOpen - swing));
+    o->pwm_out = o->randomVoltage();
   }
   else
   {
-    setEvent(GATE_OPEN, handleEventTimeOverflow(t + t_gateOpen + swing));
+    o->sequenceIndex = nextStep(o->sequenceIndex, o->sequenceLength);
+    o->pwm_out = o->steps.window(o->sequenceIndex);
   }
-  swinging = swinging ? false : true;
 }
 
+/***********************************************************
+
+    LFO (SAW, SAW_INVERTED, SINE)
+
+*/
+
 /*
-   Handle interruptCounter restart from 0
+   LFO speed as cycles in ppqn PPQN ticks. Any ratio is allowed, so rates
+   are not limited to the clock length table. Phase step is computed here,
+   never in the interrupt. The value only changes every PWM_EVENT_PPQN
+   ticks, so cycles shorter than two PWM events run at that length, half a
+   cycle per event. Anything faster would alias, and below PWM_EVENT_PPQN
+   ticks per cycle the step would overflow 32 bits.
 */
-EventTime Output::handleEventTimeOverflow(EventTime t)
+void Output::setLfoPeriod(uint32_t ppqn, uint8_t cycles)
 {
-  if (t >= INTERRUPT_COUNTER_LIMIT)
+  if (ppqn == 0 || cycles == 0)
+    lfoPhaseStep = 0;
+  else
   {
-    int t_over = t - INTERRUPT_COUNTER_LIMIT;
-    return t_over;
+    if (ppqn < 2 * PWM_EVENT_PPQN * cycles)
+      ppqn = 2 * PWM_EVENT_PPQN * cycles;
+    lfoPhaseStep = (0xFFFFFFFF / ppqn) * PWM_EVENT_PPQN * cycles;
   }
-  return t;
 }
 
 /*
-   Analog events
+   LFO rate, see LFO_RATE_MULTIPLIER. Takes effect with the next
+   setGateLength(), which computes the phase step for both.
 */
-void Output::setPwmEvent(EventTime t)
+void Output::setLfoRate(uint8_t r)
 {
-  setEvent(PWM_EVENT, handleEventTimeOverflow(t));
+  lfoRate = r < NUM_LFO_RATES ? r : LFO_RATE_X1;
 }
 
-void Output::handlePwmEvent(int t)
+/*
+   Phase offset, 256 is one full cycle. 64 on one output and 0 on another
+   with the same rate gives quadrature.
+*/
+void Output::setLfoPhaseOffset(uint8_t offset)
 {
+  lfoPhaseOffset = offset;
+}
 
-  pwmPpqnCounter++;
-
-  int totalPpqn = pwmPpqnCounter * PWM_EVENT_PPQN;
-  int mapped = 0;
-  int mappedPpqn = totalPpqn;
-
-  if (type == SINE)
-  {
-
-    double totalPpqnInRad = 2 * PI * totalPpqn / CLOCK_LENGTH_TO_PPQN[gateLength];
-    double sin_out = cos(totalPpqnInRad); // cosine to let pwm_out start at 0
-
-    int sin_out_int = (int)(sin_out * 255);
+/*
+   Advance the LFO by one PWM event and return its 8-bit phase. With hold
+   the phase stays at the offset once the cycle has completed, saws stay
+   at their start value until the clock restarts them.
+*/
+uint8_t Output::advanceLfo(bool hold)
+{
+  uint32_t phase = lfoPhase + lfoPhaseStep;
+  if (phase < lfoPhase && hold)
+    lfoCycleDone = true;
+  lfoPhase = phase;
+
+  uint8_t index = lfoPhaseOffset;
+  if (!lfoCycleDone)
+    index += lfoPhase >> 24;
+  return index;
+}
 
-    mapped = map(sin_out_int, 255, -255, 0, 255);
-    pwm_out = mapped;
-  }
-  else if (type == SAW || type == SAW_INVERTED)
-  {
+void Output::stepSaw(Output *o)
+{
+  o->pwm_out = o->advanceLfo(true);
+}
 
-    if (totalPpqn > CLOCK_LENGTH_TO_PPQN[gateLength])
-      mappedPpqn = 0; // Or fullcycleppqn instead of 0 to stay high...
-    if (type == SAW_INVERTED)
-      mapped = map(mappedPpqn, 0, CLOCK_LENGTH_TO_PPQN[gateLength], 255, 0);
-    else
-      mapped = map(mappedPpqn, 0, CLOCK_LENGTH_TO_PPQN[gateLength], 0, 255);
+void Output::stepSawInverted(Output *o)
+{
+  o->pwm_out = 255 - o->advanceLfo(true);
+}
 
-    pwm_out = mapped;
-  }
-  else if (type == VOLTAGE)
-  {
+void Output::stepSine(Output *o)
+{
+  o->pwm_out = sineLookup(o->advanceLfo(false));
+}
 
-    if (totalPpqn >= CLOCK_LENGTH_TO_PPQN[clockLength])
-    {
-      if (sequenceLength == 0)
-      {
-        pwm_out = random(255) + 1;
-      }
-      else
-      {
-        sequenceIndex++;
-        if (sequenceIndex >= sequenceLength)
-          sequenceIndex = 0;
-        pwm_out = sequence >> sequenceIndex & 0xFF;
-      }
-    }
-  }
+void Output::resetLfoPhase()
+{
+  lfoPhase = 0;
+  lfoCycleDone = false;
+}
 
-  if (totalPpqn >= CLOCK_LENGTH_TO_PPQN[clockLength] - 1)
-  {
-    pwmPpqnCounter = 0;
-  }
+/*
+   SINE waveform value for 8-bit phase (256 = one cycle), starting from 0
+   at phase 0 like the cosine it replaces.
+*/
+uint8_t Output::sineLookup(uint8_t phase)
+{
+  uint8_t quadrant = phase >> 6;
+  uint8_t index = phase & 0x3F;
+  if (quadrant & 1)
+    index = 64 - index;
+  uint8_t value = pgm_read_byte(&SINE_QUARTER_TABLE[index]);
+  if (quadrant == 1 || quadrant == 2)
+    value = 255 - value;
+  return value;
 }
 
 /***********************************************************
@@ -298,18 +359,19 @@ void Output::handlePwmEvent(int t)
 */
 void Output::setDefaultGateTimes()
 {
-  t_gateClose = CLOCK_LENGTH_TO_PPQN[gateLength];
-  if (CLOCK_LENGTH_TO_PPQN[gateLength] == CLOCK_LENGTH_TO_PPQN[clockLength])
+  uint16_t clock = pgm_read_word(&CLOCK_LENGTH_TO_PPQN[clockLength]);
+  t_gateClose = pgm_read_word(&CLOCK_LENGTH_TO_PPQN[gateLength]);
+  if (t_gateClose == clock)
   {
     t_gateClose--;
   }
-  t_gateOpen = CLOCK_LENGTH_TO_PPQN[clockLength] - t_gateClose;
+  t_gateOpen = clock - t_gateClose;
 }
 
 void Output::setDefaultGateTimesForSwingable()
 {
-  t_gateOpen = CLOCK_LENGTH_TO_PPQN[clockLength] - CLOCK_LENGTH_TO_PPQN[gateLength];
-  t_gateClose = CLOCK_LENGTH_TO_PPQN[gateLength];
+  t_gateClose = pgm_read_word(&CLOCK_LENGTH_TO_PPQN[gateLength]);
+  t_gateOpen = pgm_read_word(&CLOCK_LENGTH_TO_PPQN[clockLength]) - t_gateClose;
 }
 
 /***********************************************************
@@ -327,34 +389,73 @@ void Output::setEuclideanSteps(int k)
   this->euclideanSteps = k;
 }
 
+/*
+   Euclidean rotation.
+   r = step of the pattern played first after a reset, 0..n-1, so the
+   pattern is shifted r steps earlier
+*/
+void Output::setEuclideanRotation(uint8_t r)
+{
+  this->euclideanRotation = r;
+}
+
 /*
    Euclidean rhythm generator.
-   Generates Euclidean rhythms using Bresenham algorithm.
+   Onsets at steps ceil(i * n / k), i = 0..k-1: step j is one when j * k / n
+   passes an integer, tracked with an error term instead of dividing. The
+   same rhythm as Bjorklund's algorithm up to rotation.
 */
-int Output::generateEuclideanRhythm(uint8_t k, uint8_t n)
+void Output::generateEuclideanRhythm(uint8_t k, uint8_t n, StepBits &s)
 {
-  int euclidean = 0;
-  double slope = (double)n / (double)k;
-  double pattern_index = 0;
-  for (int i = 0; i < k; i++)
+  s.clear();
+  if (k > n)
+    k = n;
+  if (k == 0)
+    return;
+
+  uint8_t error = 0;
+  s.set(0);
+  for (uint8_t j = 1; j < n; j++)
   {
-    int index = (int)ceil(pattern_index);
-    int bit_index = n - index - 1;
-    euclidean |= 1 << bit_index;
-    pattern_index += slope;
+    error += k;
+    if (error >= n)
+    {
+      error -= n;
+      s.set(j);
+    }
   }
-  return euclidean;
 }
 
-void Output::handleEuclideanGate()
+/*
+   Pattern of k onsets in n steps, copied from EUCLIDEAN_PATTERNS up to
+   EUCLIDEAN_TABLE_LENGTH steps and generated above that.
+*/
+void Output::loadEuclideanPattern(uint8_t k, uint8_t n, StepBits &s)
 {
-  // Open gate only if euclidean step is true
-  gateOpen = (sequence >> sequenceIndex) & 1 == 1 ? true : false;
-  sequenceIndex -= 1;
-  if (sequenceIndex == 255)
+  if (k > n)
+    k = n;
+  if (k == 0 || n > EUCLIDEAN_TABLE_LENGTH)
   {
-    sequenceIndex = sequenceLength + sequenceIndex;
+    generateEuclideanRhythm(k, n, s);
+    return;
   }
+
+  const uint8_t *pattern = (const uint8_t *)&EUCLIDEAN_PATTERNS[EUCLIDEAN_PATTERN_INDEX(k, n)];
+  s.clear();
+  for (uint8_t i = 0; i < sizeof(uint32_t); i++)
+    s.bytes[i] = pgm_read_byte(pattern + i);
+}
+
+void Output::handleEuclideanGate()
+{
+  // Open gate only if euclidean step is true
+  gateOpen = steps.test(sequenceIndex);
+  sequenceIndex = nextStep(sequenceIndex, sequenceLength);
+}
+
+void Output::stepEuclidean(Output *o)
+{
+  o->handleEuclideanGate();
 }
 
 /***********************************************************
@@ -373,70 +474,32 @@ void Output::generateSequence(byte len)
       sequenceLength = MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH;
     if (sequenceLength > 0)
     {
-      sequence = random(MAX_LONG);
-      pwm_out = sequence >> sequenceIndex & 0xFF;
+      generateRandomVoltageSequence(rng, steps);
+      pwm_out = steps.window(sequenceIndex);
       sequenceIndex = 0;
     }
     else
     {
-      pwm_out = random(255) + 1;
+      pwm_out = randomVoltage();
     }
   }
   else if (type == RANDOM_TRIGGERS)
   {
-    sequence = 0;
-    sequenceB = 0;
-    if (len > 0)
-    {
-      sequence = generateRandomTriggerSequence(randomTriggerProbability, sequenceLength);
-      sequenceB = generateRandomTriggerSequence(randomTriggerProbability, sequenceLength);
-    }
+    if (sequenceLength > MAX_RANDOM_TRIGGER_LENGTH)
+      sequenceLength = MAX_RANDOM_TRIGGER_LENGTH;
+    generateRandomTriggerSequence(rng, randomTriggerProbability, sequenceLength, steps);
   }
   else if (type == EUCLIDEAN)
   {
-    sequenceIndex = sequenceLength - 2; // Reading bits... leftmost bit is index n-1, rightmost is 0, first step alreay done
-    sequence = generateEuclideanRhythm(euclideanSteps, sequenceLength);
-  }
-}
-
-int Output::generateTemporarySequence(uint8_t stype, uint8_t len)
-{
-  int s = 0;
-  if (stype == VOLTAGE)
-  {
-    if (len > MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH)
-      len = MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH;
-    if (len > 0)
-    {
-      s = random(MAX_LONG);
-    }
-  }
-  else if (stype == RANDOM_TRIGGERS)
-  {
-    if (len > 0)
-    {
-      if (len > 16)
-        len = 16;
-      s = generateRandomTriggerSequence(randomTriggerProbability, len);
-    }
+    if (sequenceLength > MAX_EUCLIDEAN_LENGTH)
+      sequenceLength = MAX_EUCLIDEAN_LENGTH;
+    loadEuclideanPattern(euclideanSteps, sequenceLength, steps);
   }
-  return s;
-}
-
-int Output::generateTemporaryEuclideanSequence(uint8_t k, uint8_t n)
-{
-  return generateEuclideanRhythm(k, n);
-}
-
-void Output::setSequence(int s)
-{
-  this->sequence = s;
 }
 
-void Output::setSequence(int s, int sB)
+void Output::setSequence(const StepBits &s)
 {
-  this->sequence = s;
-  this->sequenceB = sB;
+  this->steps = s;
 }
 
 void Output::setSequenceLength(byte len)
@@ -452,41 +515,64 @@ void Output::setSequenceLength(byte len)
 void Output::setRandomTriggerProbability(int p)
 {
   randomTriggerProbability = p;
+  randomTriggerThreshold = percentThreshold(p);
+}
+
+/*
+   Seed rng starts from on every reset(), so random triggers and voltages
+   without a sequence repeat from the clock start. 0 lets it run on.
+*/
+void Output::setRandomSeed(uint32_t s)
+{
+  rngSeed = s;
 }
 
-int Output::generateRandomTriggerSequence(byte probability, byte length)
+void Output::generateRandomTriggerSequence(RandomStream &r, byte probability, byte length, StepBits &s)
 {
   // calculates a new random trigger sequence, each step has prob p to trigger
-  int s = 0;
-  for (int i = 0; i < length /* + 1 */; i++)
+  uint16_t threshold = percentThreshold(probability);
+  s.clear();
+  for (uint8_t i = 0; i < length; i++)
   {
-    bool trigger = random(100) < probability ? true : false;
-    if (trigger)
-      s |= 1 << i;
+    if (r.chance(threshold))
+      s.set(i);
   }
-  return s;
 }
 
-void Output::handleRandomTriggersGate()
+void Output::stepRandomTriggers(Output *o)
 {
-  if (sequenceLength == 0)
+  if (o->sequenceLength == 0)
   {
-    gateOpen = random(100) < randomTriggerProbability ? true : false;
+    o->gateOpen = o->rng.chance(o->randomTriggerThreshold);
   }
   else
   {
-    if (sequenceIndex < 16)
-    {
-      gateOpen = (sequence >> sequenceIndex) & 1 == 1 ? true : false;
-    }
-    else
-    {
-      gateOpen = (sequenceB >> sequenceIndex - 16) & 1 == 1 ? true : false;
-    }
-    sequenceIndex++;
-    if (sequenceIndex >= sequenceLength)
-    {
-      sequenceIndex = 0;
-    }
+    o->gateOpen = o->steps.test(o->sequenceIndex);
+    o->sequenceIndex = nextStep(o->sequenceIndex, o->sequenceLength);
   }
 }
+
+/***********************************************************
+
+    RANDOM VOLTAGE
+
+*/
+
+/*
+   Random bits for a voltage sequence, each step reads the eight bits
+   from its own index on.
+*/
+void Output::generateRandomVoltageSequence(RandomStream &r, StepBits &s)
+{
+  for (uint8_t i = 0; i < STEP_BYTES; i++)
+    s.bytes[i] = r.next();
+}
+
+/*
+   Random CV 1..255, 0 comes out as 255
+*/
+uint8_t Output::randomVoltage()
+{
+  uint8_t v = rng.next();
+  return v ? v : 255;
+}
@@ -3,6 +3,26 @@
 
 #include <Arduino.h>
 #include "Resources.h"
+#include "CmHal.h"
+#include "StepBits.h"
+#include "RandomStream.h"
+
+class Output;
+
+typedef void (*OutputHandler)(Output *o);
+
+/*
+   What an OutputType does, one entry per type in Output::BEHAVIORS in
+   flash. setOutputType() points the output at the entry of its type, so
+   neither reset nor the tick test the type: they call its handler.
+*/
+struct OutputBehavior
+{
+  OutputHandler reset; /* Type specific part of reset()                   */
+  OutputHandler step;  /* Next gate on GATE_CLOSE, next CV on PWM_EVENT   */
+  bool cv;             /* Driven by PWM events instead of gate events     */
+  bool triggers;       /* Fixed short gates, gateLength is not used       */
+};
 
 class Output
 {
@@ -14,20 +34,27 @@ public:
   uint8_t gateLength;
   uint8_t startDelayLength;
   bool swinging;
-  byte pwm_out;
-  bool d_out;
+  byte pwm_out;           /* Next CV value, latched on the PWM event */
+  bool d_out;             /* Gate level after reset(), see CmModel::gatePorts */
   bool gateOpen;
   uint16_t t_gateOpen;
   uint16_t t_gateClose;
   uint16_t pwmPpqnCounter;
-  uint8_t event;
-  uint16_t eventTime;
-  int sequence; /* Common sequence placeholders 		*/
-  int sequenceB;
-  uint8_t sequenceIndex;  /* for euclid, triggers and     		*/
-  uint8_t sequenceLength; /* voltage.                     		*/
+  uint32_t lfoPhase;      /* 0.32 fraction of a cycle                   */
+  uint32_t lfoPhaseStep;  /* phase added per PWM event                  */
+  uint8_t lfoPhaseOffset; /* 256 is one cycle                           */
+  uint8_t lfoRate;        /* cycles per gate length, see LFO_RATE_*     */
+  bool lfoCycleDone;      /* saw has completed its cycle, hold          */
+  StepBits steps;         /* Common sequence for euclid,    */
+  uint8_t sequenceIndex;  /* triggers and voltage.          */
+  uint8_t sequenceLength;
   uint8_t euclideanSteps;
+  uint8_t euclideanRotation;
   uint8_t randomTriggerProbability;
+  uint16_t randomTriggerThreshold; /* See RandomStream::chance()     */
+  RandomStream rng;                /* Random triggers and voltages    */
+  uint32_t rngSeed;                /* Restarts rng on reset(), 0: not */
+  const OutputBehavior *behavior; /* Entry of type in BEHAVIORS */
 
   Output(uint8_t p, uint8_t a);
   ~Output();
@@ -37,30 +64,54 @@ public:
   void setClockLength(uint8_t c);
   void setGateLength(uint8_t c);
   void setStartDelayLength(uint8_t c);
+  void setLfoPeriod(uint32_t ppqn, uint8_t cycles = 1);
+  void setLfoPhaseOffset(uint8_t offset);
+  void setLfoRate(uint8_t r);
   void setEuclideanSteps(int k);
+  void setEuclideanRotation(uint8_t r);
   void setRandomTriggerProbability(int p);
+  void setRandomSeed(uint32_t s);
   void generateSequence(byte len);
-  void setSequence(int s);
-  void setSequence(int s, int sB);
+  void setSequence(const StepBits &s);
   void setSequenceLength(byte len);
-  void setDelayedEvent(Event e, EventTime t);
-  void setGateCloseEvent(EventTime t);
-  void setGateOpenEvent(EventTime t);
-  void setSwingGateOpenEvent(EventTime t, uint8_t swing);
-  void setPwmEvent(EventTime t);
-  void handlePwmEvent(int t);
+  EventTime delayedEventTime(EventTime t);
+  EventTime nextGateCloseTime(EventTime t);
+  EventTime nextGateOpenTime(EventTime t);
+  EventTime nextSwingGateOpenTime(EventTime t, uint8_t swing);
+  void handlePwmEvent();
   void setDefaultGateTimesForSwingable();
   void setDefaultGateTimes();
-  int generateEuclideanRhythm(uint8_t k, uint8_t n);
-  int generateRandomTriggerSequence(byte probability, byte length);
-  int generateTemporarySequence(uint8_t stype, uint8_t len);
-  int generateTemporaryEuclideanSequence(uint8_t k, uint8_t n);
+  static void generateEuclideanRhythm(uint8_t k, uint8_t n, StepBits &s);
+  static void loadEuclideanPattern(uint8_t k, uint8_t n, StepBits &s);
+  static void generateRandomTriggerSequence(RandomStream &r, byte probability, byte length, StepBits &s);
+  static void generateRandomVoltageSequence(RandomStream &r, StepBits &s);
+
+  bool isCv()
+  {
+    return pgm_read_byte(&behavior->cv);
+  }
 
 private:
-  void setEvent(Event e, EventTime t);
-  EventTime handleEventTimeOverflow(EventTime t);
+  static const OutputBehavior BEHAVIORS[NUM_TYPES];
+
+  void step()
+  {
+    ((OutputHandler)pgm_read_ptr(&behavior->step))(this);
+  }
+  uint8_t advanceLfo(bool hold);
+  uint8_t randomVoltage();
+  static void handleNothing(Output *o);
+  static void resetEuclidean(Output *o);
+  static void resetVoltage(Output *o);
+  static void stepEuclidean(Output *o);
+  static void stepRandomTriggers(Output *o);
+  static void stepSaw(Output *o);
+  static void stepSawInverted(Output *o);
+  static void stepSine(Output *o);
+  static void stepVoltage(Output *o);
   void handleEuclideanGate();
-  void handleRandomTriggersGate();
+  void resetLfoPhase();
+  static uint8_t sineLookup(uint8_t phase);
 };
 
 #endif
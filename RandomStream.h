@@ -0,0 +1,67 @@
+/*
+   Pseudo random numbers for Clock Module
+
+   32-bit xorshift (Marsaglia, shifts 13, 17 and 5), period 2^32 - 1.
+   Shifts and xors only, no multiply or divide, so it is cheap enough for
+   the tick. Every output has a stream of its own: outputs don't take
+   numbers from each other, and a pattern depends only on the seed of its
+   output. Probabilities are compared against a threshold out of 256
+   worked out when the setting changes, not computed per step.
+
+*/
+
+#ifndef RANDOMSTREAM_H
+#define RANDOMSTREAM_H
+
+#include <Arduino.h>
+
+struct RandomStream
+{
+  uint32_t state;
+
+  /* Any seed, 0 is mapped to a valid (non-zero) state */
+  void seed(uint32_t s)
+  {
+    state = s ? s : 0x2545F491;
+  }
+
+  uint8_t next()
+  {
+    uint32_t x = state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state = x;
+    return x >> 24;
+  }
+
+  /* True with probability threshold / 256 */
+  bool chance(uint16_t threshold)
+  {
+    return next() < threshold;
+  }
+};
+
+/*
+   Threshold for RandomStream::chance() of a probability in percent,
+   256 for 100 %
+*/
+inline uint16_t percentThreshold(uint8_t percent)
+{
+  return ((uint16_t)percent * 256 + 50) / 100;
+}
+
+/*
+   Seed of the stream of output n from a user seed or power-up entropy.
+   Mixed so that neighbouring seeds and outputs don't start out alike.
+*/
+inline uint32_t streamSeed(uint32_t seed, uint8_t n)
+{
+  uint32_t s = seed ^ (uint32_t)(n + 1) * 0x9E3779B9;
+  s ^= s >> 16;
+  s *= 0x45D9F3B;
+  s ^= s >> 16;
+  return s;
+}
+
+#endif
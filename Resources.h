@@ -18,13 +18,29 @@
 */
 #define MAX_BPM 200
 #define MIN_BPM 30
+#define BPM_FRACTION_STEPS 100 /* Tempo resolution 0.01 BPM */
 #define MAX_SWING 30
-#define MAX_EUCLIDEAN_LENGTH 32
-#define MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH 32
-#define NUM_CLOCKS 21
+#define MAX_SEQUENCE_STEPS 64 /* StepBits size, multiple of 8 */
+#define MAX_EUCLIDEAN_LENGTH MAX_SEQUENCE_STEPS
+#define MAX_RANDOM_TRIGGER_LENGTH MAX_SEQUENCE_STEPS
+#define MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH MAX_SEQUENCE_STEPS
 #define NUM_TYPES 8
 #define CLOCK_LENGTH_SWINGABLE_LIMIT 6
 #define NUM_OUTPUTS 8
+#define FIRST_PWM_OUTPUT 4
+#define NUM_PWM_OUTPUTS 4
+#define NUM_PRESETS 4
+#define MAX_RANDOM_SEED 999 /* Seed page, 0 seeds from power-up entropy */
+#define PRESET_EEPROM_SIZE 1024 /* ATmega32U4 */
+
+/***
+   External clock sync. Pulses on CLOCK_INPUT are 16th notes by default.
+*/
+#define SYNC_PULSES_PER_QUARTER 4
+#define SYNC_LOCK_PULSES 2          /* Valid intervals needed before following */
+#define SYNC_FILTER_SHIFT 2         /* Interval averaging, 1/4 of new error */
+#define SYNC_TIMEOUT_MICROS 2000000 /* Back to internal tempo after this */
+#define SYNC_DISPLAY_UPDATE_MILLIS 500
 
 /***
    Settings defaults
@@ -59,31 +75,63 @@
 #define DEBUG_INTERRUPT false
 #define DEBUG_VIEW false
 #define DEBUG_INTERRUPT_DIVIDER 6
+#define DEBUG_LOOP false
+#define DEBUG_LOOP_REPORT_MILLIS 1000
+
+/*
+   Timer1 interrupt cost statistics, see TickProfile.h. Shown on an extra
+   Diagnostics page after the Seed page and printed on serial when 'p' is
+   received ('c' clears). Takes about 100 bytes of RAM when on.
+*/
+#ifndef PROFILE_TICK
+#define PROFILE_TICK false
+#endif
+#define DIAGNOSTICS_UPDATE_MILLIS 500
 
 /*
    Timing constants
 */
 
+#define CPU_FREQ 16000000
+#define PRESCALER 8
 #define PPQN 192
-const uint16_t PROGMEM INTERRUPT_COUNTER_LIMIT = PPQN * 4 * 64;
+#define SYNC_TICKS_PER_PULSE (PPQN / SYNC_PULSES_PER_QUARTER)
+/* Pulse intervals accepted with 25% margin around the tempo range */
+#define SYNC_MIN_INTERVAL_MICROS (60000000UL / SYNC_PULSES_PER_QUARTER / (MAX_BPM + MAX_BPM / 4))
+#define SYNC_MAX_INTERVAL_MICROS (60000000UL / SYNC_PULSES_PER_QUARTER / (MIN_BPM - MIN_BPM / 4))
+/* Timer1 ticks per PPQN tick at 0.01 BPM is TIMER1_TICKS_PER_CENTIBPM / (BPM * 100) */
+#define TIMER1_TICKS_PER_CENTIBPM (CPU_FREQ / PRESCALER * 60UL / PPQN * BPM_FRACTION_STEPS)
 const uint8_t PROGMEM PWM_EVENT_PPQN = 6;
 const uint16_t PROGMEM PPQN_BAR = PPQN * 4;
-static const char *SPACE = " ";
-static const char *SPACE2 = "  ";
-static const char *ROW_INDICATOR = ">";
-static const char *ROW_INDICATOR_COMMIT = "!";
-static const char *CHAR_L = "L";
-static const char *CHAR_N = "n";
-static const char *CHAR_K = "k";
-static const char *CHAR_P = "p";
-static const char *ROW_TYPE = "Type      ";
-static const char *ROW_CLOCK = "Clock     ";
-static const char *ROW_GATE = "Gate      ";
-static const char *ROW_DELAY = "Delay     ";
-static const char *ROW_STEPS = "Steps     ";
-static const char *ROW_LENGTH = "Length    ";
-static const char *ROW_PROB = "Prob      ";
-static const char *ROW_SEQUENCE = "Sequence  ";
+
+/*
+   Tickless Timer1: the interrupt fires on the next PPQN tick with work to
+   do instead of on every one, see CmModel::scheduleWake(). Set to false
+   for one interrupt per tick.
+*/
+#ifndef TICKLESS
+#define TICKLESS true
+#endif
+static const char *const SPACE = " ";
+static const char *const SPACE2 = "  ";
+static const char *const ROW_INDICATOR = ">";
+static const char *const ROW_INDICATOR_COMMIT = "!";
+static const char *const ROW_INDICATOR_ARMED = "*";
+static const char *const CHAR_L = "L";
+static const char *const CHAR_N = "n";
+static const char *const CHAR_K = "k";
+static const char *const CHAR_P = "p";
+static const char *const ROW_TYPE = "Type      ";
+static const char *const ROW_CLOCK = "Clock     ";
+static const char *const ROW_GATE = "Gate      ";
+static const char *const ROW_DELAY = "Delay     ";
+static const char *const ROW_STEPS = "Steps     ";
+static const char *const ROW_LENGTH = "Length    ";
+static const char *const ROW_PROB = "Prob      ";
+static const char *const ROW_SEQUENCE = "Sequence  ";
+static const char *const ROW_PHASE = "Phase     ";
+static const char *const ROW_RATE = "Rate      ";
+static const char *const ROW_ROTATE = "Rotate    ";
 
 /*******************************************************************
 
@@ -91,37 +139,7 @@ static const char *ROW_SEQUENCE = "Sequence  ";
 
 */
 
-const uint16_t CLOCK_LENGTH_TO_PPQN[] = {
-    /* 0  NO_DELAY*/ 0,
-    /* 1  1x256   */ PPQN >> 6,
-    /* 2  1x128   */ PPQN >> 5,
-    /* 3  1x64    */ PPQN >> 4,
-    /* 4  1x32    */ PPQN >> 3,
-    /* 5  1x16    */ PPQN >> 2,
-    /* 6  1x16D   */ (PPQN >> 2) + (PPQN >> 3),
-    /* 7  1x8     */ PPQN >> 1,
-    /* 8  1x8D    */ (PPQN >> 1) + (PPQN >> 2),
-    /* 9  1x4     */ PPQN >> 0,
-    /* 10  1x4D   */ (PPQN >> 0) + (PPQN >> 1),
-    /* 11  1x2    */ PPQN << 1,
-    /* 12  1x2D   */ (PPQN << 1) + (PPQN >> 0),
-    /* 13  1x1    */ PPQN << 2,
-    /* 14  1x1D   */ (PPQN << 2) + (PPQN << 1),
-    /* 15 2x1     */ PPQN << 3,
-    /* 16 3x1     */ (PPQN << 3) + (PPQN << 2),
-    /* 17 4x1     */ PPQN << 4,
-    /* 18 6x1     */ (PPQN << 4) + (PPQN << 3),
-    /* 19 8x1     */ PPQN >> 5,
-    /* 20 12x1    */ (PPQN >> 5) + (PPQN >> 4),
-    /* 21 16x1    */ PPQN >> 6,
-    /* 22 24x1    */ (PPQN >> 6) + (PPQN >> 5),
-    /* 23 32x1    */ PPQN >> 7,
-    /* 24 48x1    */ (PPQN >> 7) + (PPQN >> 6),
-    /* 25 64x1    */ PPQN >> 8
-
-};
-
-typedef enum Event
+enum Event
 {
   NO_EVENT = 0,
   GATE_OPEN = 1,
@@ -129,9 +147,30 @@ typedef enum Event
   PWM_EVENT = 3
 };
 
-typedef int EventTime;
+/*
+   Event times are PPQN ticks since the clock started, see
+   CmModel::interruptCounter. Unsigned 32-bit so times and differences
+   wrap modulo 2^32 and stay exact across the wrap; compare times by
+   their difference, never by < or >.
+*/
+typedef uint32_t EventTime;
 
-typedef enum OutputType
+/*
+   Pending events are kept in a timing wheel of EVENT_WHEEL_SIZE slots,
+   each slot a bit mask of outputs (bit n = output n).
+*/
+#define EVENT_WHEEL_SIZE 64
+#define EVENT_WHEEL_MASK (EVENT_WHEEL_SIZE - 1)
+
+#if NUM_OUTPUTS <= 8
+typedef uint8_t OutputMask;
+#elif NUM_OUTPUTS <= 16
+typedef uint16_t OutputMask;
+#else
+typedef uint32_t OutputMask;
+#endif
+
+enum OutputType
 {
   NO_OUTPUT = 0,
   CLOCK = 1,
@@ -143,7 +182,7 @@ typedef enum OutputType
   VOLTAGE = 7
 };
 
-static const char *TYPE_TO_STR[] = {
+static const char *const TYPE_TO_STR[] = {
     "----",
     "Gate",
     "Eucl",
@@ -153,7 +192,7 @@ static const char *TYPE_TO_STR[] = {
     "Sine",
     "Volt"};
 
-static const char *TYPE_TO_LONG_STR[] = {
+static const char *const TYPE_TO_LONG_STR[] = {
     "-",
     "Gate",
     "Euclidean",
@@ -163,98 +202,207 @@ static const char *TYPE_TO_LONG_STR[] = {
     "Sine",
     "Voltages"};
 
-typedef enum ClockLength
+/*
+   Clock lengths: enum name, length as numerator and denominator of a
+   whole note (four quarters), and the short and long display strings.
+   Everything below is generated from this list. Presets store the enum
+   value, so the order is fixed by the preset format: new lengths are
+   appended at the end, never inserted in length order.
+*/
+#define CLOCK_LENGTHS(X)                \
+  X(1x256, 1, 256, " 256 ", "1/256")    \
+  X(1x128, 1, 128, " 128 ", "1/128")    \
+  X(1x64, 1, 64, "  64 ", "1/64")       \
+  X(1x32, 1, 32, "  32 ", "1/32")       \
+  X(1x16, 1, 16, "  16 ", "1/16")       \
+  X(1x16D, 3, 32, "  16.", "1/16.")     \
+  X(1x8, 1, 8, "   8 ", "1/8")          \
+  X(1x8D, 3, 16, "   8.", "1/8.")       \
+  X(1x4, 1, 4, "   4 ", "1/4")          \
+  X(1x4D, 3, 8, "   4.", "1/4.")        \
+  X(1x2, 1, 2, "   2 ", "1/2")          \
+  X(1x2D, 3, 4, "   2.", "1/2.")        \
+  X(1x1, 1, 1, "   1 ", "1/1")          \
+  X(1x1D, 3, 2, "  1x.", "1/1.")        \
+  X(2x1, 2, 1, "  2x ", "2/1")          \
+  X(3x1, 3, 1, "  3x ", "3/1")          \
+  X(4x1, 4, 1, "  4x ", "4/1")          \
+  X(6x1, 6, 1, "  6x ", "6/1")          \
+  X(8x1, 8, 1, "  8x ", "8/1")          \
+  X(12x1, 12, 1, " 12x ", "12/1")       \
+  X(16x1, 16, 1, " 16x ", "16/1")       \
+  X(24x1, 24, 1, " 24x ", "24/1")       \
+  X(32x1, 32, 1, " 32x ", "32/1")       \
+  X(48x1, 48, 1, " 48x ", "48/1")       \
+  X(64x1, 64, 1, " 64x ", "64/1")
+
+constexpr uint32_t clockRatioToPpqn(uint32_t numerator, uint32_t denominator)
+{
+  return PPQN * 4UL * numerator / denominator;
+}
+
+enum ClockLength
 {
   NO_CLOCK = 0,
-  CLOCK_1x256 = 1,
-  CLOCK_1x128 = 2,
-  CLOCK_1x64 = 3,
-  CLOCK_1x32 = 4,
-  CLOCK_1x16 = 5,
-  CLOCK_1x16D = 6,
-  CLOCK_1x8 = 7,
-  CLOCK_1x8D = 8,
-  CLOCK_1x4 = 9,
-  CLOCK_1x4D = 10,
-  CLOCK_1x2 = 11,
-  CLOCK_1x2D = 12,
-  CLOCK_1x1 = 13,
-  CLOCK_1x1D = 14,
-  CLOCK_2x1 = 15,
-  CLOCK_3x1 = 16,
-  CLOCK_4x1 = 17,
-  CLOCK_6x1 = 18,
-  CLOCK_8x1 = 19,
-  CLOCK_12x1 = 20,
-  CLOCK_16x1 = 21
+#define X(name, numerator, denominator, str, longStr) CLOCK_##name,
+  CLOCK_LENGTHS(X)
+#undef X
+  CLOCK_LENGTH_END
+};
+
+#define NUM_CLOCKS (CLOCK_LENGTH_END - 1)
+
+/* Fails if the list is reordered, which would remap saved presets */
+static_assert(CLOCK_1x4 == 9 && CLOCK_1x1 == 13 && CLOCK_16x1 == 21, "CLOCK_LENGTHS order changed");
+
+/*
+   Every length must be a whole number of PPQN ticks and fit the 16-bit
+   gate times of Output (t_gateOpen, t_gateClose).
+*/
+#define X(name, numerator, denominator, str, longStr)                                                  \
+  static_assert(PPQN * 4UL * numerator % denominator == 0, "CLOCK_" #name " is not whole PPQN ticks"); \
+  static_assert(clockRatioToPpqn(numerator, denominator) <= 0xFFFF, "CLOCK_" #name " does not fit 16 bits");
+CLOCK_LENGTHS(X)
+#undef X
+
+/* Read with pgm_read_word() */
+const uint16_t PROGMEM CLOCK_LENGTH_TO_PPQN[] = {
+    0, /* NO_CLOCK, no start delay */
+#define X(name, numerator, denominator, str, longStr) clockRatioToPpqn(numerator, denominator),
+    CLOCK_LENGTHS(X)
+#undef X
 };
 
-static const char *CLOCK_TO_STR[] = {
+static const char *const CLOCK_TO_STR[] = {
     "     ",
-    " 256 ",
-    " 128 ",
-    "  64 ",
-    "  32 ",
-    "  16 ",
-    "  16.",
-    "   8 ",
-    "   8.",
-    "   4 ",
-    "   4.",
-    "   2 ",
-    "   2.",
-    "   1 ",
-    "  1x.",
-    "  2x ",
-    "  3x ",
-    "  4x ",
-    "  6x ",
-    "  8x ",
-    " 12x ",
-    " 16x "
-    //  " 24x "
-    //  " 32x "
-    //  " 48x ",
-    //  " 64x "
+#define X(name, numerator, denominator, str, longStr) str,
+    CLOCK_LENGTHS(X)
+#undef X
 };
 
-static const char *CLOCK_TO_LONG_STR[] = {
+static const char *const CLOCK_TO_LONG_STR[] = {
     "-",
-    "1/256",
-    "1/128",
-    "1/64",
-    "1/32",
-    "1/16",
-    "1/16.",
-    "1/8",
-    "1/8.",
-    "1/4",
-    "1/4.",
-    "1/2",
-    "1/2.",
-    "1/1",
-    "1/1.",
-    "2/1",
-    "3/1",
-    "4/1",
-    "6/1",
-    "8/1",
-    "12/1",
-    "16/1"
-    //  "24/1"
-    //  "32/1"
-    //  "48/1",
-    //  "64/1"
+#define X(name, numerator, denominator, str, longStr) longStr,
+    CLOCK_LENGTHS(X)
+#undef X
 };
 
-typedef enum Mode
+/* LFO phase offset in steps of LFO_PHASE_OFFSET_STEP (256 = one cycle) */
+#define LFO_PHASE_OFFSET_STEP 32
+
+static const char *const PHASE_TO_STR[] = {
+    "0",
+    "45",
+    "90",
+    "135",
+    "180",
+    "225",
+    "270",
+    "315"};
+
+/*
+   LFO rate: cycles of the LFO per gate length, LFO_RATE_MULTIPLIER[rate]
+   cycles in LFO_RATE_DIVISOR[rate] gate lengths. Read with pgm_read_byte().
+*/
+#define NUM_LFO_RATES 9
+#define LFO_RATE_X1 4
+
+const uint8_t PROGMEM LFO_RATE_MULTIPLIER[NUM_LFO_RATES] = {1, 1, 1, 2, 1, 3, 2, 3, 4};
+const uint8_t PROGMEM LFO_RATE_DIVISOR[NUM_LFO_RATES] = {4, 3, 2, 3, 1, 2, 1, 1, 1};
+
+static const char *const LFO_RATE_TO_STR[] = {
+    "x1/4",
+    "x1/3",
+    "x1/2",
+    "x2/3",
+    "x1",
+    "x3/2",
+    "x2",
+    "x3",
+    "x4"};
+
+/*
+   Commit quantum: staged output settings and swing changes take effect on
+   the next multiple of QUANTUM_TO_PPQN[quantum] ticks from clock start.
+*/
+#define NUM_QUANTUMS 6
+#define DEFAULT_QUANTUM QUANTUM_BAR
+
+enum Quantum
+{
+  QUANTUM_16TH = 0,
+  QUANTUM_BEAT = 1,
+  QUANTUM_BAR = 2,
+  QUANTUM_2_BARS = 3,
+  QUANTUM_4_BARS = 4,
+  QUANTUM_8_BARS = 5
+};
+
+const uint16_t QUANTUM_TO_PPQN[] = {
+    PPQN / 4,
+    PPQN,
+    PPQN * 4,
+    PPQN * 4 * 2,
+    PPQN * 4 * 4,
+    PPQN * 4 * 8};
+
+static const char *const QUANTUM_TO_STR[] = {
+    "1/16",
+    "Beat",
+    "Bar",
+    "2 Bars",
+    "4 Bars",
+    "8 Bars"};
+
+enum Mode
 {
   MODE_BPM = 0,
   MODE_SWING = 1,
   MODE_OUTPUT_LIST = 2,
-  MODE_OUTPUT_SETTINGS = 3
+  MODE_OUTPUT_SETTINGS = 3,
+  MODE_COMMIT = 4,     /* Setup pages, long press on Swing */
+  MODE_PRESET = 5,
+  MODE_SEED = 6,
+  MODE_DIAGNOSTICS = 7 /* Only with PROFILE_TICK */
 };
 
+/*
+   Preset page: rotary selects one of PRESET_ACTIONS, long press runs it
+*/
+#define PRESET_ACTIONS (NUM_PRESETS * 2) /* Load 1..n, Save 1..n */
+
+enum PresetStatus
+{
+  PRESET_IDLE = 0,
+  PRESET_LOADED = 1,
+  PRESET_EMPTY = 2,
+  PRESET_SAVING = 3,
+  PRESET_SAVED = 4,
+  PRESET_BUSY = 5
+};
+
+static const char *const PRESET_ACTION_TO_STR[] = {
+    "Load ",
+    "Save "};
+
+static const char *const PRESET_STATUS_TO_STR[] = {
+    "",
+    "loaded",
+    "empty",
+    "saving",
+    "saved",
+    "busy"};
+
+/*
+   Tick kinds of the Diagnostics page, NO_EVENT..PWM_EVENT, TICK_COMMIT
+*/
+static const char *const TICK_KIND_TO_STR[] = {
+    "Idle",
+    "Open",
+    "Close",
+    "PWM",
+    "Commit"};
+
 /*
    Memory usage debug tool
 */
@@ -276,7 +424,7 @@ typedef enum Mode
 // #endif  // __arm__
 // }
 
-static void printFreeMem()
+static inline void printFreeMem()
 {
   //  Serial.print(F("Free mem: "));
   //  Serial.print(freeMemory());
@@ -0,0 +1,61 @@
+/*
+   Step pattern storage for Clock Module
+
+   One bit per step, step j in bit j & 7 of byte j >> 3, up to
+   MAX_SEQUENCE_STEPS steps. Used by Euclidean, random trigger and voltage
+   outputs. Reading a step is one byte load and shift whatever the step
+   number, so the gate handlers in the tick don't branch on pattern length.
+
+*/
+
+#ifndef STEPBITS_H
+#define STEPBITS_H
+
+#include <Arduino.h>
+#include "Resources.h"
+
+#define STEP_BYTES (MAX_SEQUENCE_STEPS / 8)
+#define STEP_BYTES_MASK (STEP_BYTES - 1)
+
+struct StepBits
+{
+  uint8_t bytes[STEP_BYTES];
+
+  void clear()
+  {
+    for (uint8_t i = 0; i < STEP_BYTES; i++)
+      bytes[i] = 0;
+  }
+
+  bool test(uint8_t step) const
+  {
+    return (bytes[step >> 3] >> (step & 7)) & 1;
+  }
+
+  void set(uint8_t step)
+  {
+    bytes[step >> 3] |= 1 << (step & 7);
+  }
+
+  /*
+     Eight steps from step on as a byte, wrapping from the last step of
+     the storage to the first. Voltage outputs read their values with it.
+  */
+  uint8_t window(uint8_t step) const
+  {
+    uint8_t i = step >> 3;
+    uint16_t w = bytes[i & STEP_BYTES_MASK] | (uint16_t)bytes[(i + 1) & STEP_BYTES_MASK] << 8;
+    return w >> (step & 7);
+  }
+};
+
+/*
+   Step after step in a pattern of len steps
+*/
+inline uint8_t nextStep(uint8_t step, uint8_t len)
+{
+  step++;
+  return step >= len ? 0 : step;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+   Timer1 interrupt cost statistics for Clock Module
+
+   Built in when PROFILE_TICK is set. The tick reads TCNT1 when it starts
+   and when it ends and records the difference, in Timer1 counts of
+   0.5 us, under the kind of work the tick did: its most expensive event,
+   or a commit of staged changes. Costs are counted in a histogram of
+   power of two buckets, the first for ticks shorter than
+   TICK_PROFILE_FIRST_BUCKET counts, the last for everything longer than
+   the one before it. A tick that still runs when the next compare match
+   is due has overrun its period: the next interrupt comes late.
+
+   Written by the tick only. The main loop reads it with
+   CmModel::copyTickProfile() and clears it with clearTickProfile().
+
+*/
+
+#ifndef TICKPROFILE_H
+#define TICKPROFILE_H
+
+#include <Arduino.h>
+#include "Resources.h"
+
+#define TICK_PROFILE_BUCKETS 8
+#define TICK_PROFILE_FIRST_BUCKET 16 /* Timer1 counts, 8 us */
+
+/* Tick kinds, NO_EVENT..PWM_EVENT are those of Event */
+#define TICK_COMMIT 4
+#define NUM_TICK_KINDS 5
+
+struct TickProfile
+{
+  uint16_t histogram[NUM_TICK_KINDS][TICK_PROFILE_BUCKETS]; /* Saturate */
+  uint16_t worst[NUM_TICK_KINDS];
+  uint16_t overruns;
+  uint32_t ticks;
+
+  void clear()
+  {
+    memset(this, 0, sizeof(*this));
+  }
+
+  void record(uint8_t kind, uint16_t cost, bool overrun)
+  {
+    uint8_t b = 0;
+    for (uint16_t c = cost / TICK_PROFILE_FIRST_BUCKET; c && b < TICK_PROFILE_BUCKETS - 1; c >>= 1)
+      b++;
+    if (histogram[kind][b] != 0xFFFF)
+      histogram[kind][b]++;
+    if (cost > worst[kind])
+      worst[kind] = cost;
+    if (overrun && overruns != 0xFFFF)
+      overruns++;
+    ticks++;
+  }
+
+  /* Upper limit of bucket b in Timer1 counts, 0 for the last one */
+  static uint16_t bucketLimit(uint8_t b)
+  {
+    return b < TICK_PROFILE_BUCKETS - 1 ? TICK_PROFILE_FIRST_BUCKET << b : 0;
+  }
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+   Minimal Arduino.h for the host simulator build.
+
+   Only what the sequencing code (Output, CmModel) needs to compile on a
+   normal C++ toolchain. Hardware access itself goes through CmHal.h.
+
+*/
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void *const *)(addr))
+#define F(s) (s)
+
+#define PI 3.1415926535897932384626433832795
+#define HIGH 1
+#define LOW 0
+
+/* Arduino Micro analog pin numbers */
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+#define A4 22
+#define A5 23
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+/* Implemented by the simulator */
+long random(long max);
+unsigned long millis();
+unsigned long micros();
+
+/* Serial output is only used for debug prints, which go nowhere */
+class SimSerial
+{
+public:
+  template <typename T>
+  void print(T) {}
+  template <typename T>
+  void println(T) {}
+  void println() {}
+};
+
+static SimSerial Serial __attribute__((unused));
+
+#endif
@@ -0,0 +1,321 @@
+/*
+   Host simulator for Clock Module
+
+*/
+
+#include <chrono>
+#include <string.h>
+#include "CmSim.h"
+#include "CmHal.h"
+#include "CmModel.h"
+
+CmSim::CmSim()
+{
+  timerCompare = 0;
+  recording = true;
+  vcd = NULL;
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  eepromWrites = 0;
+  reset(1);
+}
+
+void CmSim::reset(uint32_t seed)
+{
+  ticks = 0;
+  wakeups = 0;
+  timerTicks = 0;
+  ns = 0;
+  gates = 0;
+  for (uint8_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+  {
+    pwm[i] = 0;
+    pwmChanges[i].clear();
+  }
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    edges[i].clear();
+  }
+  this->seed = seed;
+  randomState = seed ? seed : 1;
+  extIntervalNs = 0;
+  extJitterMicros = 0;
+  extNextPulseNs = 0;
+  extPulses = 0;
+  extMaxPhaseError = 0;
+}
+
+/*
+   Clock input pulses at SYNC_PULSES_PER_QUARTER per beat of centiBpm/100,
+   each timestamp moved by up to +-jitterMicros.
+*/
+void CmSim::setExternalClock(uint32_t centiBpm, uint32_t jitterMicros)
+{
+  extIntervalNs = 60000000000ULL * BPM_FRACTION_STEPS / SYNC_PULSES_PER_QUARTER / centiBpm;
+  extJitterMicros = jitterMicros;
+  extNextPulseNs = ns;
+}
+
+void CmSim::setTimerCompare(uint32_t ocr)
+{
+  timerCompare = ocr;
+}
+
+/*
+   Run the tick body for numTicks PPQN ticks. Each call advances virtual
+   time by the Timer1 period in effect after the tick body has run, as
+   the compare value written in the interrupt applies to the period just
+   started. With TICKLESS that period spans model->wakeTicks ticks, and
+   the run can end up to that many ticks past numTicks.
+*/
+void CmSim::run(uint32_t numTicks)
+{
+  CmModel *model = CmModel::getInstance();
+  uint32_t end = ticks + numTicks;
+
+  while (ticks < end)
+  {
+    while (extIntervalNs && extNextPulseNs <= ns)
+    {
+      int8_t phaseError = model->interruptCounter % SYNC_TICKS_PER_PULSE;
+      if (phaseError >= SYNC_TICKS_PER_PULSE / 2)
+        phaseError -= SYNC_TICKS_PER_PULSE;
+      if (model->syncActive && ++extPulses > SIM_SYNC_SETTLE_PULSES)
+      {
+        uint8_t e = phaseError < 0 ? -phaseError : phaseError;
+        if (e > extMaxPhaseError)
+          extMaxPhaseError = e;
+      }
+
+      long jitter = extJitterMicros ? random(2 * extJitterMicros + 1) - extJitterMicros : 0;
+      model->syncPulse(extNextPulseNs / 1000 + jitter);
+      extNextPulseNs += extIntervalNs;
+    }
+
+    model->tick();
+    wakeups++;
+    ticks += model->wakeTicks;
+    timerTicks += timerCompare + 1;
+    ns = timerTicksToNs(timerTicks);
+  }
+}
+
+void CmSim::writeGates(uint8_t g)
+{
+  uint8_t changed = gates ^ g;
+  gates = g;
+
+  if ((!recording && !vcd) || !changed)
+    return;
+
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    if (changed & (1 << i))
+    {
+      bool level = (g & (1 << i)) != 0;
+      if (recording)
+      {
+        SimEdge e = {ticks, ns, level};
+        edges[i].push_back(e);
+      }
+      if (vcd)
+      {
+        vcdTime();
+        vcdGate(i, level);
+      }
+    }
+  }
+}
+
+void CmSim::writePwm(uint8_t n, uint8_t value)
+{
+  if (pwm[n] == value)
+    return;
+  pwm[n] = value;
+
+  if (recording)
+  {
+    SimPwmChange c = {ticks, ns, value};
+    pwmChanges[n].push_back(c);
+  }
+  if (vcd)
+  {
+    vcdTime();
+    vcdPwm(n, value);
+  }
+}
+
+/*
+   VCD identifiers are single printable characters: '0' + n for the gate
+   of output n, 'a' + n for the PWM value of output FIRST_PWM_OUTPUT + n.
+*/
+void CmSim::startVcd(FILE *f)
+{
+  vcd = f;
+  fprintf(vcd, "$version cmsim $end\n");
+  fprintf(vcd, "$timescale 1 ns $end\n");
+  fprintf(vcd, "$scope module clockmodule $end\n");
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+    fprintf(vcd, "$var wire 1 %c gate%u $end\n", '0' + i, i);
+  for (uint8_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+    fprintf(vcd, "$var reg 8 %c cv%u $end\n", 'a' + i, FIRST_PWM_OUTPUT + i);
+  fprintf(vcd, "$upscope $end\n");
+  fprintf(vcd, "$enddefinitions $end\n");
+
+  vcdNs = ns;
+  fprintf(vcd, "#%llu\n$dumpvars\n", (unsigned long long)ns);
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+    vcdGate(i, gates & (1 << i));
+  for (uint8_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+    vcdPwm(i, pwm[i]);
+  fprintf(vcd, "$end\n");
+}
+
+void CmSim::stopVcd()
+{
+  if (!vcd)
+    return;
+  vcdTime();
+  fclose(vcd);
+  vcd = NULL;
+}
+
+void CmSim::vcdTime()
+{
+  if (ns != vcdNs)
+  {
+    vcdNs = ns;
+    fprintf(vcd, "#%llu\n", (unsigned long long)ns);
+  }
+}
+
+void CmSim::vcdGate(uint8_t n, bool level)
+{
+  fputc(level ? '1' : '0', vcd);
+  fputc('0' + n, vcd);
+  fputc('\n', vcd);
+}
+
+void CmSim::vcdPwm(uint8_t n, uint8_t value)
+{
+  char bits[9];
+  uint8_t i = 0;
+
+  /* Binary without leading zeros, as VCD writers do */
+  for (int8_t b = 7; b >= 0; b--)
+  {
+    if (i || (value >> b) & 1 || b == 0)
+      bits[i++] = '0' + ((value >> b) & 1);
+  }
+  bits[i] = 0;
+  fprintf(vcd, "b%s %c\n", bits, 'a' + n);
+}
+
+/*
+   Deterministic stand-in for Arduino random(max), so simulated runs are
+   reproducible for a given seed.
+*/
+long CmSim::random(long max)
+{
+  if (max <= 0)
+    return 0;
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return (long)(randomState % (uint64_t)max);
+}
+
+/*
+   Arduino.h and display library host implementation
+*/
+uint32_t simDisplayBytes = 0;
+
+long random(long max)
+{
+  return CmSim::getInstance()->random(max);
+}
+
+unsigned long millis()
+{
+  return CmSim::getInstance()->ns / 1000000;
+}
+
+unsigned long micros()
+{
+  return CmSim::getInstance()->ns / 1000;
+}
+
+/*
+   CmHal.h host implementation
+*/
+void halWriteGatePorts(const volatile uint8_t *ports)
+{
+  uint8_t gates = 0;
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    if (ports[pgm_read_byte(&GATE_PORT[i])] & pgm_read_byte(&GATE_BIT[i]))
+      gates |= 1 << i;
+  }
+  CmSim::getInstance()->writeGates(gates);
+}
+
+void halPwmInit()
+{
+}
+
+void halPwmLatch(const volatile uint8_t *values)
+{
+  for (uint8_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+  {
+    CmSim::getInstance()->writePwm(i, values[i]);
+  }
+}
+
+void halSetTimerCompare(uint16_t ocr)
+{
+  CmSim::getInstance()->setTimerCompare(ocr);
+}
+
+uint16_t halTimerCompare()
+{
+  return CmSim::getInstance()->timerCompare;
+}
+
+uint16_t halTimerCount()
+{
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  return ns / (1000000000ULL / (CPU_FREQ / PRESCALER));
+}
+
+/* Virtual time stands still during a tick, the next one can't be due */
+bool halTimerOverrun()
+{
+  return false;
+}
+
+/* The simulator seed, so runs are reproducible */
+uint32_t halEntropy()
+{
+  return CmSim::getInstance()->seed;
+}
+
+uint8_t halEepromRead(uint16_t address)
+{
+  return CmSim::getInstance()->eeprom[address];
+}
+
+bool halEepromReady()
+{
+  return true;
+}
+
+void halEepromWrite(uint16_t address, uint8_t value)
+{
+  CmSim *sim = CmSim::getInstance();
+  if (sim->eeprom[address] != value)
+  {
+    sim->eeprom[address] = value;
+    sim->eepromWrites++;
+  }
+}
@@ -0,0 +1,114 @@
+/*
+   Host simulator for Clock Module
+
+   Drives CmModel::tick() at virtual PPQN time on a normal Linux box and
+   implements the CmHal.h functions. Gate edges and PWM value changes are
+   recorded per output with tick and nanosecond timestamps, where each
+   tick lasts as long as the Timer1 compare value set for it. They can
+   also be streamed to a VCD file as they happen, which takes no memory
+   however long the run.
+
+*/
+
+#ifndef CMSIM_H
+#define CMSIM_H
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <vector>
+#include "Resources.h"
+
+#define SIM_SYNC_SETTLE_PULSES 32
+
+struct SimEdge
+{
+  uint32_t tick;
+  uint64_t ns;
+  bool level;
+};
+
+struct SimPwmChange
+{
+  uint32_t tick;
+  uint64_t ns;
+  uint8_t value;
+};
+
+class CmSim
+{
+private:
+  // Private constructor to achieve singleton pattern
+  CmSim();
+  CmSim(CmSim const &);         // Copy disabled
+  void operator=(CmSim const &); // Assigment disabled
+
+  uint8_t gates;
+  uint8_t pwm[NUM_PWM_OUTPUTS];
+  uint64_t randomState;
+
+  FILE *vcd;
+  uint64_t vcdNs; /* Last timestamp written to vcd */
+  void vcdTime();
+  void vcdGate(uint8_t n, bool level);
+  void vcdPwm(uint8_t n, uint8_t value);
+
+public:
+  /* Seed of reset(), also the power-up entropy of the model */
+  uint32_t seed;
+
+  // Static method to get the instance
+  static CmSim *getInstance()
+  {
+    static CmSim sim;
+    return &sim;
+  };
+
+  /* Virtual time */
+  uint32_t ticks;
+  uint32_t wakeups; /* Timer1 interrupts, fewer than ticks with TICKLESS */
+  uint64_t timerTicks;
+  uint64_t ns;
+  uint32_t timerCompare;
+
+  /* External clock on the clock input, off when extIntervalNs is 0 */
+  uint64_t extIntervalNs;
+  uint32_t extJitterMicros;
+  uint64_t extNextPulseNs;
+  uint32_t extPulses;
+  uint8_t extMaxPhaseError; /* PPQN ticks, after the first SIM_SYNC_SETTLE_PULSES */
+
+  /* Kept over reset(), erased (0xFF) when the simulator starts */
+  uint8_t eeprom[PRESET_EEPROM_SIZE];
+  uint32_t eepromWrites;
+
+  /* Recorded output activity, cleared by reset() */
+  bool recording;
+  std::vector<SimEdge> edges[NUM_OUTPUTS];
+  std::vector<SimPwmChange> pwmChanges[NUM_PWM_OUTPUTS];
+
+  void reset(uint32_t seed);
+  void setTimerCompare(uint32_t ocr);
+  void setExternalClock(uint32_t centiBpm, uint32_t jitterMicros);
+  void run(uint32_t numTicks);
+
+  /*
+     Stream gate edges and PWM value changes to f as a VCD file with 1 ns
+     resolution, starting with the current levels. stopVcd() ends the
+     file at the current time and closes it.
+  */
+  void startVcd(FILE *f);
+  void stopVcd();
+
+  /* 500 ns per timer tick, a whole number, so no intermediate overflow */
+  uint64_t timerTicksToNs(uint64_t t)
+  {
+    return t * (PRESCALER * 1000000000ULL / CPU_FREQ);
+  }
+
+  /* CmHal.h backend */
+  void writeGates(uint8_t g);
+  void writePwm(uint8_t n, uint8_t value);
+  long random(long max);
+};
+
+#endif
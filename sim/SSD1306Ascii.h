@@ -0,0 +1,126 @@
+/*
+   Host simulator stand-in for the SSD1306Ascii library.
+
+   Draws nothing, but counts the bytes the real library would send to the
+   display: three command bytes per cursor move and one data byte per
+   pixel column written.
+
+*/
+#ifndef SIM_SSD1306ASCII_H
+#define SIM_SSD1306ASCII_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Bytes sent to the display so far, defined in CmSim.cpp */
+extern uint32_t simDisplayBytes;
+
+struct SimFont
+{
+  uint8_t width;  /* Average glyph width in pixels, spacing excluded */
+  uint8_t rows;   /* Height in 8 pixel pages */
+};
+
+struct SimDevice
+{
+  uint8_t width;
+  uint8_t rows;
+};
+
+static const SimDevice SH1106_128x64 = {128, 8};
+static const SimFont Stang5x7 = {5, 1};
+static const SimFont Iain5x7 = {5, 1};
+static const SimFont Arial_bold_14 = {8, 2};
+static const SimFont Verdana_digits_24 = {14, 3};
+
+class SSD1306Ascii
+{
+protected:
+  const SimFont *font;
+  uint8_t m_col;
+  uint8_t m_row;
+
+  void command(uint8_t n) { simDisplayBytes += n; }
+  void data(uint16_t n) { simDisplayBytes += n; }
+
+public:
+  SSD1306Ascii() : font(&Stang5x7), m_col(0), m_row(0) {}
+
+  void setFont(const SimFont &f) { font = &f; }
+  uint8_t col() { return m_col; }
+  uint16_t strWidth(const char *s) { return strlen(s) * (font->width + 1); }
+  uint8_t row() { return m_row; }
+
+  void setCursor(uint8_t c, uint8_t r)
+  {
+    m_col = c;
+    m_row = r;
+    command(3);
+  }
+
+  void clear()
+  {
+    for (uint8_t r = 0; r < 8; r++)
+    {
+      command(3);
+      data(128);
+    }
+    setCursor(0, 0);
+  }
+
+  void clearToEOL()
+  {
+    if (m_col >= 128)
+      return;
+    for (uint8_t r = 0; r < font->rows; r++)
+    {
+      command(3);
+      data(128 - m_col);
+    }
+    command(3);
+  }
+
+  size_t write(const char *s)
+  {
+    size_t n = strlen(s);
+    for (size_t i = 0; i < n; i++)
+    {
+      uint8_t w = font->width + 1;
+      if (m_col + w > 128)
+        w = m_col < 128 ? 128 - m_col : 0;
+      data(w * font->rows);
+      m_col += w;
+    }
+    return n;
+  }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(char *s) { return write(s); }
+  size_t print(long v)
+  {
+    char buf[12];
+    snprintf(buf, sizeof(buf), "%ld", v);
+    return write(buf);
+  }
+  size_t print(int v) { return print((long)v); }
+  size_t print(unsigned int v) { return print((long)v); }
+  size_t print(unsigned long v) { return print((long)v); }
+  size_t print(uint8_t v) { return print((long)v); }
+  size_t println()
+  {
+    m_col = 0;
+    m_row += font->rows;
+    command(3);
+    return 0;
+  }
+  template <typename T>
+  size_t println(T v)
+  {
+    size_t n = print(v);
+    println();
+    return n;
+  }
+};
+
+#endif
@@ -0,0 +1,15 @@
+/*
+   Host simulator stand-in for the SSD1306AsciiWire library.
+*/
+#ifndef SIM_SSD1306ASCIIWIRE_H
+#define SIM_SSD1306ASCIIWIRE_H
+
+#include "SSD1306Ascii.h"
+
+class SSD1306AsciiWire : public SSD1306Ascii
+{
+public:
+  void begin(const SimDevice *, uint8_t) {}
+};
+
+#endif
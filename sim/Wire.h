@@ -0,0 +1,18 @@
+/*
+   Host simulator stand-in for the Arduino Wire library.
+*/
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include <stdint.h>
+
+class SimTwoWire
+{
+public:
+  void begin() {}
+  void setClock(uint32_t) {}
+};
+
+static SimTwoWire Wire __attribute__((unused));
+
+#endif
@@ -0,0 +1,391 @@
+/*
+   cmbench: time the sequencing hot paths on the host
+
+   Usage: cmbench [-r repeats] [-b bars] [-c baseline]
+
+     -r repeats  timed runs per benchmark, the fastest counts (default 20)
+     -b bars     bars per timed tick run (default 200)
+     -c baseline compare against an earlier cmbench output saved to a file
+
+   Times Output::handlePwmEvent for each CV type, generateEuclideanRhythm,
+   generateRandomTriggerSequence, the gate event times and the whole
+   CmModel::tick() body under eight-channel configurations. For the tick
+   it reports the mean per PPQN tick, the worst single call and the Timer1
+   interrupts per bar, fewer than PPQN_BAR with TICKLESS. The worst case
+   is the slowest call in a four bar window, where each call counts with
+   its fastest time over WORST_CASE_REPEATS runs per repeat. The window
+   replays identically every run, since stopping the clock resets the
+   outputs and their random streams. Single calls are near the resolution
+   of the host clock, so expect the worst case to move by about 10 %
+   between runs, the means by 1 or 2 %.
+
+   Taking the fastest run keeps results steady: other load on the host
+   only ever makes a run slower. Times are host nanoseconds, good for
+   comparing builds on the same machine, not AVR cycles. Each line is a
+   name and a value, so the output saved from one build is the baseline
+   for the next.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "CmModel.h"
+#include "CmSim.h"
+
+#define BENCH_SEED 1
+#define WORST_CASE_BARS 4
+#define WORST_CASE_REPEATS 10 /* Window runs per repeat, one is short */
+#define MAX_BASELINE 64
+
+struct BenchOutput
+{
+  uint8_t type; /* NO_OUTPUT: keep the power-up setting */
+  uint8_t clockLength;
+  uint8_t gateLength;
+  uint8_t sequenceLength;
+  uint8_t value; /* Euclidean k, trigger probability or LFO phase offset */
+};
+
+struct BenchConfig
+{
+  const char *name;
+  BenchOutput outputs[NUM_OUTPUTS];
+};
+
+static const BenchConfig CONFIGS[] = {
+    {"defaults", {}},
+    {"gates64",
+     {{CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0},
+      {CLOCK, CLOCK_1x64, CLOCK_1x128, 0, 0}}},
+    {"mixed",
+     {{CLOCK, CLOCK_1x16, CLOCK_1x32, 0, 0},
+      {CLOCK, CLOCK_1x8D, CLOCK_1x16, 0, 0},
+      {EUCLIDEAN, CLOCK_1x16, CLOCK_1x128, MAX_EUCLIDEAN_LENGTH, 23},
+      {RANDOM_TRIGGERS, CLOCK_1x16, CLOCK_1x128, 0, 50},
+      {SAW, CLOCK_1x1, CLOCK_1x1, 0, 0},
+      {SINE, CLOCK_2x1, CLOCK_2x1, 0, 64},
+      {VOLTAGE, CLOCK_1x4, CLOCK_1x4, MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH, 0},
+      {RANDOM_TRIGGERS, CLOCK_1x32, CLOCK_1x128, MAX_RANDOM_TRIGGER_LENGTH, 30}}},
+    {"cv",
+     {{CLOCK, CLOCK_1x16, CLOCK_1x32, 0, 0},
+      {EUCLIDEAN, CLOCK_1x16, CLOCK_1x128, 16, 5},
+      {RANDOM_TRIGGERS, CLOCK_1x16, CLOCK_1x128, 0, 70},
+      {CLOCK, CLOCK_1x4, CLOCK_1x8, 0, 0},
+      {SAW_INVERTED, CLOCK_1x2, CLOCK_1x2, 0, 0},
+      {SINE, CLOCK_1x1, CLOCK_1x1, 0, 0},
+      {SAW, CLOCK_1x4, CLOCK_1x4, 0, 128},
+      {VOLTAGE, CLOCK_1x8, CLOCK_1x8, 0, 0}}},
+    {"sparse",
+     {{CLOCK, CLOCK_4x1, CLOCK_1x8, 0, 0},
+      {CLOCK, CLOCK_4x1, CLOCK_1x8, 0, 0},
+      {CLOCK, CLOCK_2x1, CLOCK_1x8, 0, 0},
+      {CLOCK, CLOCK_2x1, CLOCK_1x8, 0, 0},
+      {CLOCK, CLOCK_1x1, CLOCK_1x8, 0, 0},
+      {CLOCK, CLOCK_1x1, CLOCK_1x8, 0, 0},
+      {CLOCK, CLOCK_1x1, CLOCK_1x16, 0, 0},
+      {CLOCK, CLOCK_1x1, CLOCK_1x16, 0, 0}}}};
+
+#define NUM_CONFIGS (sizeof(CONFIGS) / sizeof(CONFIGS[0]))
+
+static uint32_t repeats = 20;
+static uint32_t bars = 200;
+
+static char baselineNames[MAX_BASELINE][32];
+static double baselineValues[MAX_BASELINE];
+static int numBaseline = 0;
+
+/* Results go here so the compiler can't drop the timed work */
+static volatile uint32_t sink;
+
+static double nowNs()
+{
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void loadBaseline(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    fprintf(stderr, "can't read %s\n", path);
+    exit(1);
+  }
+  char line[128];
+  while (numBaseline < MAX_BASELINE && fgets(line, sizeof(line), f))
+  {
+    if (sscanf(line, "%31s %lf", baselineNames[numBaseline], &baselineValues[numBaseline]) == 2)
+      numBaseline++;
+  }
+  fclose(f);
+}
+
+static void report(const char *name, double value, const char *unit)
+{
+  printf("%-28s %9.2f %s", name, value, unit);
+  for (int i = 0; i < numBaseline; i++)
+  {
+    if (!strcmp(baselineNames[i], name) && baselineValues[i] > 0)
+      printf("  %+6.1f %%", (value - baselineValues[i]) * 100 / baselineValues[i]);
+  }
+  printf("\n");
+}
+
+/*
+   Fastest time per call of f(i), i = 0..calls-1, over all repeats
+*/
+template <typename F>
+static double bestNsPerCall(uint32_t calls, F f)
+{
+  double best = 1e30;
+  for (uint32_t r = 0; r < repeats; r++)
+  {
+    double start = nowNs();
+    for (uint32_t i = 0; i < calls; i++)
+      f(i);
+    double ns = (nowNs() - start) / calls;
+    if (ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+/***********************************************************
+
+    OUTPUT FUNCTIONS
+
+*/
+
+static void benchPwmEvent(const char *name, uint8_t type, uint8_t clockLength, uint8_t sequenceLength)
+{
+  static Output o(PIN_OUTPUT7, PIN_ANALOG7);
+  RandomStream r;
+
+  r.seed(BENCH_SEED);
+  o.setOutputType(type);
+  o.setClockLength(clockLength);
+  o.setGateLength(clockLength);
+  o.setStartDelayLength(NO_CLOCK);
+  o.setSequenceLength(sequenceLength);
+  if (type == VOLTAGE)
+    Output::generateRandomVoltageSequence(r, o.steps);
+  o.reset();
+
+  report(name, bestNsPerCall(1000000, [](uint32_t) {
+           o.handlePwmEvent();
+           sink += o.pwm_out;
+         }),
+         "ns/call");
+}
+
+static void benchOutputFunctions()
+{
+  benchPwmEvent("pwm_saw", SAW, CLOCK_1x1, 0);
+  benchPwmEvent("pwm_saw_inverted", SAW_INVERTED, CLOCK_1x1, 0);
+  benchPwmEvent("pwm_sine", SINE, CLOCK_1x1, 0);
+  benchPwmEvent("pwm_voltage_sequence", VOLTAGE, CLOCK_1x16, MAX_RANDOM_VOLTAGE_SEQUENCE_LENGTH);
+  benchPwmEvent("pwm_voltage_random", VOLTAGE, CLOCK_1x16, 0);
+
+  /* Every pattern up to the longest, k <= n */
+  static StepBits s;
+  uint32_t patterns = MAX_EUCLIDEAN_LENGTH * (MAX_EUCLIDEAN_LENGTH + 1) / 2;
+  report("euclidean_rhythm", bestNsPerCall(patterns, [](uint32_t i) {
+           uint8_t n = 1;
+           while (i >= n)
+             i -= n++;
+           Output::generateEuclideanRhythm(i + 1, n, s);
+           sink += s.bytes[0];
+         }),
+         "ns/call");
+  report("euclidean_pattern", bestNsPerCall(patterns, [](uint32_t i) {
+           uint8_t n = 1;
+           while (i >= n)
+             i -= n++;
+           Output::loadEuclideanPattern(i + 1, n, s);
+           sink += s.bytes[0];
+         }),
+         "ns/call");
+
+  static RandomStream r;
+  r.seed(BENCH_SEED);
+  report("random_triggers_64", bestNsPerCall(100000, [](uint32_t) {
+           Output::generateRandomTriggerSequence(r, 50, MAX_RANDOM_TRIGGER_LENGTH, s);
+           sink += s.bytes[0];
+         }),
+         "ns/call");
+
+  static Output o(PIN_OUTPUT0, NO_ANALOG_OUTPUT);
+  o.setOutputType(CLOCK);
+  o.setClockLength(CLOCK_1x16);
+  o.setGateLength(CLOCK_1x32);
+  o.setStartDelayLength(NO_CLOCK);
+  o.reset();
+  o.setDefaultGateTimesForSwingable();
+  report("swing_gate_time", bestNsPerCall(10000000, [](uint32_t i) {
+           sink += o.nextSwingGateOpenTime(i, 5) + o.nextGateCloseTime(i);
+         }),
+         "ns/call");
+}
+
+/***********************************************************
+
+    TICK
+
+*/
+
+static void restartClock(CmModel *model)
+{
+  model->setRunning(false);
+  model->processCommands();
+  model->setRunning(true);
+  model->processCommands();
+}
+
+static void configure(CmModel *model, const BenchConfig &config)
+{
+  model->setRunning(false);
+  model->processCommands();
+
+  for (uint8_t n = 0; n < NUM_OUTPUTS; n++)
+  {
+    const BenchOutput &b = config.outputs[n];
+    if (b.type == NO_OUTPUT)
+      continue;
+
+    OutputSettings s;
+    s.type = b.type;
+    s.clockLength = b.clockLength;
+    s.gateLength = b.gateLength;
+    s.startDelayLength = NO_CLOCK;
+    s.lfoPhaseOffset = b.value;
+    s.lfoRate = LFO_RATE_X1;
+    s.euclideanSteps = b.value;
+    s.euclideanRotation = 0;
+    s.randomTriggerProbability = b.value;
+    s.sequenceLength = b.sequenceLength;
+    s.steps.clear();
+    if (b.type == EUCLIDEAN)
+      Output::loadEuclideanPattern(b.value, b.sequenceLength, s.steps);
+    else
+      model->generateRandomSteps(n, b.type, b.sequenceLength, b.value, s.steps);
+    model->submitOutputSettings(n, s);
+    model->processCommands();
+  }
+  model->commitStagedOutputs();
+  model->processCommands();
+
+  for (uint8_t n = 0; n < NUM_OUTPUTS; n++)
+  {
+    model->outputs[n]->setRandomSeed(streamSeed(BENCH_SEED, n));
+  }
+  restartClock(model);
+}
+
+static void benchTick(CmModel *model, const BenchConfig &config)
+{
+  char name[32];
+  uint32_t numTicks = bars * PPQN_BAR;
+  uint32_t windowTicks = WORST_CASE_BARS * PPQN_BAR;
+  static double tickNs[WORST_CASE_BARS * PPQN_BAR];
+
+  configure(model, config);
+
+  /* With TICKLESS one call covers model->wakeTicks ticks */
+  double best = 1e30;
+  uint32_t wakeups = 0;
+  for (uint32_t r = 0; r < repeats; r++)
+  {
+    restartClock(model);
+    wakeups = 0;
+    double start = nowNs();
+    for (uint32_t t = 0; t < numTicks; t += model->wakeTicks, wakeups++)
+      model->tick();
+    double ns = (nowNs() - start) / numTicks;
+    if (ns < best)
+      best = ns;
+  }
+
+  /* Cost of reading the clock, taken off every single tick time */
+  double clockNs = 1e30;
+  for (uint32_t i = 0; i < 10000; i++)
+  {
+    double t = nowNs();
+    t = nowNs() - t;
+    if (t < clockNs)
+      clockNs = t;
+  }
+
+  for (uint32_t i = 0; i < windowTicks; i++)
+    tickNs[i] = 1e30;
+  for (uint32_t r = 0; r < repeats * WORST_CASE_REPEATS; r++)
+  {
+    restartClock(model);
+    for (uint32_t t = 0; t < windowTicks; t += model->wakeTicks)
+    {
+      double start = nowNs();
+      model->tick();
+      double ns = nowNs() - start - clockNs;
+      if (ns < tickNs[t])
+        tickNs[t] = ns;
+    }
+  }
+  uint32_t worst = 0;
+  for (uint32_t i = 1; i < windowTicks; i++)
+  {
+    if (tickNs[i] < 1e30 && tickNs[i] > tickNs[worst])
+      worst = i;
+  }
+
+  snprintf(name, sizeof(name), "tick_%s", config.name);
+  report(name, best, "ns/tick");
+  snprintf(name, sizeof(name), "tick_%s_worst", config.name);
+  report(name, tickNs[worst] > 0 ? tickNs[worst] : 0, "ns");
+  printf("%-28s %9u\n", "  at tick", worst + 1);
+  snprintf(name, sizeof(name), "tick_%s_interrupts", config.name);
+  report(name, (double)wakeups * PPQN_BAR / numTicks, "/bar");
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      repeats = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      bars = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+      loadBaseline(argv[++i]);
+    else
+    {
+      fprintf(stderr, "usage: %s [-r repeats] [-b bars] [-c baseline]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (repeats == 0 || bars == 0)
+  {
+    fprintf(stderr, "repeats and bars must be at least 1\n");
+    return 1;
+  }
+
+  CmSim *sim = CmSim::getInstance();
+  CmModel *model = CmModel::getInstance();
+
+  sim->reset(BENCH_SEED);
+  sim->recording = false;
+  model->initialize();
+
+  printf("repeats %u, %u bars per tick run, worst case over %u bars\n", repeats, bars, WORST_CASE_BARS);
+  benchOutputFunctions();
+  for (uint8_t i = 0; i < NUM_CONFIGS; i++)
+    benchTick(model, CONFIGS[i]);
+
+  return 0;
+}
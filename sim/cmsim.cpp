@@ -0,0 +1,227 @@
+/*
+   cmsim: run the Clock Module sequencing code on the host
+
+   Usage: cmsim [-b bars] [-t bpm] [-s seed] [-e output] [-n] [-v file]
+                [-o output:type:clock:gate[:phase] ...] [-x bpm[:jitter]]
+
+     -b bars    number of bars to simulate (default 1000)
+     -t bpm     tempo with up to two decimals (default DEFAULT_BPM)
+     -s seed    random seed (default 1)
+     -e output  print every recorded edge of one output (0-7), and for
+                outputs 4-7 also every PWM value change
+     -n         do not record edges, measure raw tick throughput only
+     -v file    write gates and PWM values to file as VCD (GTKWave etc.)
+                while the simulation runs, with nanosecond timestamps.
+                Edges are not kept in memory then, so any length of run
+                takes the same memory; -e and the edge summary are off
+     -o o:t:c:g[:p]
+                set output o to OutputType t, ClockLength c and gate
+                length g, e.g. -o 6:6:15:15 for a 2/1 sine on output 6.
+                Optional p is the LFO phase offset, 256 is one cycle
+
+     -x bpm[:j] external clock on the clock input at bpm, SYNC_PULSES_PER_QUARTER
+                pulses per beat, each pulse jittered by up to +-j microseconds
+
+   Outputs start from CmModel::setupDefaultOutputs() as on power-up, then
+   -o settings are committed through the same path as the settings page.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "CmModel.h"
+#include "CmSim.h"
+
+int main(int argc, char **argv)
+{
+  uint32_t bars = 1000;
+  double bpm = DEFAULT_BPM;
+  uint32_t seed = 1;
+  int edgeOutput = -1;
+  bool record = true;
+  double extBpm = 0;
+  int extJitter = 0;
+  int numSettings = 0;
+  const char *vcdPath = NULL;
+  int settings[NUM_OUTPUTS][5];
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-b") && i + 1 < argc)
+      bars = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+      bpm = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      seed = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+      edgeOutput = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-x") && i + 1 < argc)
+      sscanf(argv[++i], "%lf:%d", &extBpm, &extJitter);
+    else if (!strcmp(argv[i], "-n"))
+      record = false;
+    else if (!strcmp(argv[i], "-v") && i + 1 < argc)
+      vcdPath = argv[++i];
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc && numSettings < NUM_OUTPUTS)
+    {
+      int *o = settings[numSettings++];
+      o[4] = 0;
+      if (sscanf(argv[++i], "%d:%d:%d:%d:%d", &o[0], &o[1], &o[2], &o[3], &o[4]) < 4 ||
+          o[0] < 0 || o[0] >= NUM_OUTPUTS || o[1] < CLOCK || o[1] >= NUM_TYPES ||
+          o[2] < 1 || o[2] > NUM_CLOCKS || o[3] < 1 || o[3] > NUM_CLOCKS || o[4] < 0 || o[4] > 255 ||
+          (o[0] < FIRST_PWM_OUTPUT && o[1] > RANDOM_TRIGGERS))
+      {
+        fprintf(stderr, "bad output setting %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-b bars] [-t bpm] [-s seed] [-e output] [-n] [-v file] [-o o:t:c:g[:p]] [-x bpm[:j]]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  uint32_t centiBpm = (uint32_t)(bpm * BPM_FRACTION_STEPS + 0.5);
+  if (centiBpm < MIN_BPM * BPM_FRACTION_STEPS || centiBpm > MAX_BPM * BPM_FRACTION_STEPS)
+  {
+    fprintf(stderr, "bpm must be %d..%d\n", MIN_BPM, MAX_BPM);
+    return 1;
+  }
+
+  CmSim *sim = CmSim::getInstance();
+  CmModel *model = CmModel::getInstance();
+
+  sim->reset(seed);
+  sim->recording = record;
+
+  model->initialize();
+  for (int i = 0; i < numSettings; i++)
+  {
+    Output *o = (Output *)model->outputs[settings[i][0]];
+    model->currentOutput = settings[i][0];
+    model->editType = settings[i][1];
+    model->editClockLength = settings[i][2];
+    model->editGateLength = settings[i][3];
+    model->editLfoPhaseOffset = settings[i][4];
+    model->editStartDelayLength = NO_CLOCK;
+    model->editSequenceLength = o->sequenceLength;
+    model->editEuclideanSteps = o->euclideanSteps;
+    model->editEuclideanRotation = o->euclideanRotation;
+    model->editRandomTriggerProbability = o->randomTriggerProbability;
+    model->editSteps = o->steps;
+    if (model->editType == EUCLIDEAN)
+      Output::loadEuclideanPattern(model->editEuclideanSteps, model->editSequenceLength, model->editSteps);
+    model->submitOutputSettingsChange();
+    model->processCommands();
+  }
+  model->commitStagedOutputs();
+  model->processCommands();
+  model->BPM = centiBpm / BPM_FRACTION_STEPS;
+  model->bpmFraction = centiBpm % BPM_FRACTION_STEPS;
+  model->updateClockPeriod();
+  model->setRunning(true);
+  if (extBpm > 0)
+    sim->setExternalClock((uint32_t)(extBpm * BPM_FRACTION_STEPS + 0.5), extJitter);
+
+  uint32_t numTicks = bars * PPQN_BAR;
+
+  if (vcdPath)
+  {
+    FILE *f = fopen(vcdPath, "w");
+    if (!f)
+    {
+      fprintf(stderr, "can't write %s\n", vcdPath);
+      return 1;
+    }
+    static char buffer[1 << 16];
+    setvbuf(f, buffer, _IOFBF, sizeof(buffer));
+    sim->recording = record = false;
+    sim->startVcd(f);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  sim->run(numTicks);
+  auto end = std::chrono::steady_clock::now();
+  sim->stopVcd();
+  double wallSeconds = std::chrono::duration<double>(end - start).count();
+
+  /* Drift against the exact tempo, in timer ticks to avoid rounding */
+  double exactTimerTicks = (double)sim->ticks * TIMER1_TICKS_PER_CENTIBPM / centiBpm;
+  double driftNs = (sim->timerTicks - exactTimerTicks) * PRESCALER * 1e9 / CPU_FREQ;
+
+  printf("bpm %u.%02u, %u bars, %u ticks, period %u+%u/%u, simulated %.3f s\n",
+         centiBpm / BPM_FRACTION_STEPS, centiBpm % BPM_FRACTION_STEPS, bars, numTicks,
+         model->clockPeriod, model->clockRemainder, model->clockDivisor, sim->ns / 1e9);
+  if (extBpm > 0)
+  {
+    uint16_t detected = model->syncCentiBpm();
+    printf("sync %s, external %.2f bpm, detected %u.%02u bpm, max phase error %u ticks after %u pulses\n",
+           model->syncActive ? "locked" : "not locked", extBpm, detected / BPM_FRACTION_STEPS,
+           detected % BPM_FRACTION_STEPS, sim->extMaxPhaseError, SIM_SYNC_SETTLE_PULSES);
+  }
+  else
+    printf("drift %.3f us (%.3f ppm)\n", driftNs / 1e3, driftNs / (sim->ns / 1e6));
+  printf("timer interrupts %u, %.1f per bar\n", sim->wakeups, (double)sim->wakeups * PPQN_BAR / sim->ticks);
+  printf("wall %.3f s, %.0f bars/s, %.1f ns/tick\n",
+         wallSeconds, bars / wallSeconds, wallSeconds * 1e9 / numTicks);
+  if (numSettings > 0)
+    printf("largest staged commit %.1f us host time\n", model->commitTimerTicksMax * 1e6 / (CPU_FREQ / PRESCALER));
+
+#if PROFILE_TICK
+  /* Host time again, so mostly the first bucket; shows the tick kinds */
+  TickProfile profile;
+  model->copyTickProfile(profile);
+  printf("tick profile, %u ticks, %u overruns\n", profile.ticks, profile.overruns);
+  for (uint8_t k = 0; k < NUM_TICK_KINDS; k++)
+  {
+    uint32_t count = 0;
+    for (uint8_t b = 0; b < TICK_PROFILE_BUCKETS; b++)
+      count += profile.histogram[k][b];
+    printf("  %-6s %8u ticks, worst %.1f us host time\n", TICK_KIND_TO_STR[k], count, profile.worst[k] * 1e6 / (CPU_FREQ / PRESCALER));
+  }
+#endif
+
+  if (!record)
+    return 0;
+
+  printf("\nout  type  rising  falling  first rise (tick)\n");
+  for (uint8_t i = 0; i < NUM_OUTPUTS; i++)
+  {
+    uint32_t rising = 0;
+    uint32_t falling = 0;
+    long firstRise = -1;
+    for (const SimEdge &e : sim->edges[i])
+    {
+      if (e.level)
+      {
+        if (firstRise < 0)
+          firstRise = e.tick;
+        rising++;
+      }
+      else
+        falling++;
+    }
+    printf("%3u  %s  %6u  %7u  %ld\n", i, TYPE_TO_STR[model->outputs[i]->type], rising, falling, firstRise);
+  }
+  for (uint8_t i = 0; i < NUM_PWM_OUTPUTS; i++)
+  {
+    printf("pwm %u: %zu value changes\n", i + FIRST_PWM_OUTPUT, sim->pwmChanges[i].size());
+  }
+
+  if (edgeOutput >= 0 && edgeOutput < NUM_OUTPUTS)
+  {
+    printf("\nedges of output %d: tick ns level\n", edgeOutput);
+    for (const SimEdge &e : sim->edges[edgeOutput])
+      printf("%u %llu %d\n", e.tick, (unsigned long long)e.ns, e.level);
+
+    if (edgeOutput >= FIRST_PWM_OUTPUT)
+    {
+      printf("\npwm of output %d: tick ns value\n", edgeOutput);
+      for (const SimPwmChange &c : sim->pwmChanges[edgeOutput - FIRST_PWM_OUTPUT])
+        printf("%u %llu %u\n", c.tick, (unsigned long long)c.ns, c.value);
+    }
+  }
+
+  return 0;
+}
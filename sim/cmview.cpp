@@ -0,0 +1,127 @@
+/*
+   cmview: count display bytes per render for typical UI actions
+
+   Usage: cmview
+
+   Runs CmView against a display stub that counts the command and data
+   bytes the SSD1306Ascii library would send over I2C, and prints them
+   per render and per render slice for a scripted sequence of encoder and
+   button actions. Slice time is the I2C time of its bytes at 400 kHz,
+   which bounds how long one main loop pass waits on the display.
+
+*/
+
+#include <stdio.h>
+#include "CmModel.h"
+#include "CmView.h"
+#include "CmSim.h"
+
+/* 8 data bits and an ACK per byte at 400 kHz */
+#define I2C_NANOS_PER_BYTE 22500
+
+static CmModel *model;
+static CmView *view;
+
+struct Stats
+{
+  const char *name;
+  uint32_t renders;
+  uint32_t bytes;
+  uint32_t maxBytes;
+  uint32_t slices;
+  uint32_t maxSliceBytes;
+};
+
+static void measuredRender(Stats &s)
+{
+  /* One tick for the model to take queued changes, clock is stopped */
+  CmSim::getInstance()->run(1);
+
+  uint32_t before = simDisplayBytes;
+  view->render();
+  do
+  {
+    uint32_t sliceBefore = simDisplayBytes;
+    bool more = view->renderSlice();
+    uint32_t sb = simDisplayBytes - sliceBefore;
+    s.slices++;
+    if (sb > s.maxSliceBytes)
+      s.maxSliceBytes = sb;
+    if (!more)
+      break;
+  } while (true);
+  uint32_t b = simDisplayBytes - before;
+  s.renders++;
+  s.bytes += b;
+  if (b > s.maxBytes)
+    s.maxBytes = b;
+}
+
+static void print(const Stats &s)
+{
+  printf("%-28s %4u renders  %6u bytes  avg %5u  max %5u  slices %4u  max slice %4u (%5u us)\n",
+         s.name, s.renders, s.bytes, s.renders ? s.bytes / s.renders : 0, s.maxBytes,
+         s.slices, s.maxSliceBytes, s.maxSliceBytes * I2C_NANOS_PER_BYTE / 1000);
+}
+
+int main()
+{
+  model = CmModel::getInstance();
+  view = CmView::getInstance();
+  view->setModel(model);
+  CmSim::getInstance()->reset(1);
+  model->initialize();
+
+  Stats bpmOpen = {"BPM page open", 0, 0, 0, 0, 0};
+  Stats bpmTurn = {"BPM page, turn encoder", 0, 0, 0, 0, 0};
+  Stats listOpen = {"Output list open", 0, 0, 0, 0, 0};
+  Stats listTurn = {"Output list, move cursor", 0, 0, 0, 0, 0};
+  Stats settingsOpen = {"Settings page open", 0, 0, 0, 0, 0};
+  Stats settingsTurn = {"Settings page, edit values", 0, 0, 0, 0, 0};
+
+  measuredRender(bpmOpen);
+  for (uint8_t i = 0; i < 20; i++)
+  {
+    model->handleRotary(i < 10);
+    measuredRender(bpmTurn);
+  }
+
+  model->handleButtonLongPress();
+  measuredRender(listOpen);
+  for (uint8_t i = 0; i < 14; i++)
+  {
+    model->handleRotary(i < 7);
+    measuredRender(listTurn);
+  }
+
+  for (uint8_t output = 0; output < NUM_OUTPUTS; output += 3)
+  {
+    model->currentRow = output;
+    model->handleButton();
+    measuredRender(settingsOpen);
+    for (uint8_t row = 0; row < 4; row++)
+    {
+      for (uint8_t i = 0; i < 4; i++)
+      {
+        model->handleRotary(i < 2);
+        measuredRender(settingsTurn);
+      }
+      model->handleButton();
+      measuredRender(settingsTurn);
+    }
+    while (model->currentMode == MODE_OUTPUT_SETTINGS)
+    {
+      model->handleButton();
+      measuredRender(settingsTurn);
+    }
+    measuredRender(listOpen);
+  }
+
+  print(bpmOpen);
+  print(bpmTurn);
+  print(listOpen);
+  print(listTurn);
+  print(settingsOpen);
+  print(settingsTurn);
+  return 0;
+}